@@ -35,9 +35,36 @@ long long bench_atomic() {
     return std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count();
 }
 
+// One padded slot per thread: no cache line is shared between writers.
+// Reading sums the slots (see lecture7/code18 for the full version).
+struct ShardedCounter {
+    struct alignas(64) Slot { std::atomic<long long> v{0}; };
+    Slot slots[THREADS];
+    void add(int t) { slots[t].v.fetch_add(1, std::memory_order_relaxed); }
+    long long value() const {
+        long long s = 0;
+        for (const auto& x : slots) s += x.v.load(std::memory_order_relaxed);
+        return s;
+    }
+};
+
+long long bench_sharded() {
+    ShardedCounter counter;
+    auto s = clock_type::now();
+    std::vector<std::thread> ts;
+    for (int t = 0; t < THREADS; ++t)
+        ts.emplace_back([&, t]{ for (int i = 0; i < N; ++i) counter.add(t); });
+    for (auto& th : ts) th.join();
+    auto e = clock_type::now();
+    if (counter.value() != THREADS * N) std::cerr << "wrong: " << counter.value() << "\n";
+    return std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count();
+}
+
 int main() {
     auto m = bench_mutex();
     auto a = bench_atomic();
-    std::cout << "Mutex:  " << m << " ms\n";
-    std::cout << "Atomic: " << a << " ms\n";
+    auto sh = bench_sharded();
+    std::cout << "Mutex:   " << m << " ms\n";
+    std::cout << "Atomic:  " << a << " ms\n";
+    std::cout << "Sharded: " << sh << " ms\n";
 }
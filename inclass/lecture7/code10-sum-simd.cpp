@@ -0,0 +1,211 @@
+// sum_range_simd.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code10-sum-simd.cpp -o code10
+//
+// SumRangeJob with a 64-bit result path:
+//   - JobResult::value is std::int64_t (the README's int overflows at 1..10M)
+//   - contiguous ranges use the closed form (l + r) * count / 2, computed in
+//     128 bits; a sum that does not fit in 64 bits fails instead of wrapping
+//   - ArraySumJob sums real int32 data into 64-bit lanes with AVX2 or SSE4.1,
+//     picked once at runtime, with a scalar fallback for other CPUs
+// main() checks the paths agree and micro-benchmarks them.
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SUM_HAVE_X86 1
+#else
+#define SUM_HAVE_X86 0
+#endif
+
+// ---------------- Jobs ----------------
+struct JobResult {
+    bool success;
+    std::string message;
+    std::int64_t value;
+};
+
+class Job {
+public:
+    virtual ~Job() = default;
+    virtual JobResult run() = 0;
+};
+
+// Sum of l..r inclusive (empty range sums to 0).
+class SumRangeJob : public Job {
+public:
+    SumRangeJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+
+    JobResult run() override {
+        if (l_ > r_) return {true, "OK", 0};
+        __int128 count = static_cast<__int128>(r_) - l_ + 1;
+        __int128 sum = (static_cast<__int128>(l_) + r_) * count / 2;    // (l + r) * count is always even
+        if (sum > std::numeric_limits<std::int64_t>::max() ||
+            sum < std::numeric_limits<std::int64_t>::min())
+            return {false, "Failed: sum overflows 64 bits", 0};
+        return {true, "OK", static_cast<std::int64_t>(sum)};
+    }
+
+private:
+    std::int64_t l_, r_;
+};
+
+// ---------------- Array reduction kernels ----------------
+namespace simd {
+
+std::int64_t sum_scalar(const std::int32_t* p, std::size_t n) {
+    std::int64_t s = 0;
+    for (std::size_t i = 0; i < n; ++i) s += p[i];
+    return s;
+}
+
+#if SUM_HAVE_X86
+__attribute__((target("sse4.1")))
+std::int64_t sum_sse41(const std::int32_t* p, std::size_t n) {
+    __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        acc0 = _mm_add_epi64(acc0, _mm_cvtepi32_epi64(v));                      // lanes 0,1
+        acc1 = _mm_add_epi64(acc1, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));   // lanes 2,3
+    }
+    alignas(16) std::int64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi64(acc0, acc1));
+    return lanes[0] + lanes[1] + sum_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+std::int64_t sum_avx2(const std::int32_t* p, std::size_t n) {
+    // Four independent accumulators so consecutive adds do not wait on each other.
+    __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+    __m256i a2 = _mm256_setzero_si256(), a3 = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 8));
+        a0 = _mm256_add_epi64(a0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        a1 = _mm256_add_epi64(a1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+        a2 = _mm256_add_epi64(a2, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(w)));
+        a3 = _mm256_add_epi64(a3, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(w, 1)));
+    }
+    __m256i acc = _mm256_add_epi64(_mm256_add_epi64(a0, a1), _mm256_add_epi64(a2, a3));
+    alignas(32) std::int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_scalar(p + i, n - i);
+}
+#endif
+
+using SumFn = std::int64_t (*)(const std::int32_t*, std::size_t);
+
+struct Kernel {
+    const char* name;
+    SumFn fn;
+};
+
+// Best kernel this CPU supports; resolved once.
+const Kernel& best() {
+    static const Kernel k = [] {
+#if SUM_HAVE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))   return Kernel{"avx2", sum_avx2};
+        if (__builtin_cpu_supports("sse4.1")) return Kernel{"sse4.1", sum_sse41};
+#endif
+        return Kernel{"scalar", sum_scalar};
+    }();
+    return k;
+}
+
+} // namespace simd
+
+// Sum of an int32 array into a 64-bit result. 2^32 elements of INT32_MAX
+// still fit in int64, so no overflow check is needed for in-memory data.
+class ArraySumJob : public Job {
+public:
+    ArraySumJob(const std::int32_t* data, std::size_t n) : data_(data), n_(n) {}
+
+    JobResult run() override {
+        return {true, "OK", simd::best().fn(data_, n_)};
+    }
+
+private:
+    const std::int32_t* data_;
+    std::size_t n_;
+};
+
+// ---------------- Demo / micro-benchmark ----------------
+// The naive loop. The empty asm stops GCC from turning it into the closed
+// form itself, which would make the comparison meaningless.
+std::int64_t sum_loop(std::int64_t l, std::int64_t r) {
+    std::int64_t s = 0;
+    for (std::int64_t i = l; i <= r; ++i) {
+        s += i;
+        asm volatile("" : "+r"(s));
+    }
+    return s;
+}
+
+template<class Fn>
+double best_of_ms(int reps, Fn&& fn) {
+    double best = 1e300;
+    for (int i = 0; i < reps; ++i) {
+        auto s = std::chrono::steady_clock::now();
+        fn();
+        auto e = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(e - s).count());
+    }
+    return best;
+}
+
+int main() {
+    // The README example that overflowed with int.
+    JobResult r = SumRangeJob(1, 10'000'000).run();
+    std::cout << "sum(1..1e7)   = " << r.value << " (" << r.message << ")\n";   // 50000005000000
+    r = SumRangeJob(-5, 5).run();
+    std::cout << "sum(-5..5)    = " << r.value << "\n";                          // 0
+    r = SumRangeJob(1, 10'000'000'000LL).run();
+    std::cout << "sum(1..1e10)  = " << r.value << "\n";                          // fails: 5e19 > INT64_MAX
+    std::cout << "                " << r.message << "\n";
+    r = SumRangeJob(1, 4'000'000'000LL).run();
+    std::cout << "sum(1..4e9)   = " << r.value << "\n";                          // 8000000002000000000
+
+    volatile std::int64_t sink = 0;
+    std::int64_t loop_val = 0;
+    double t_loop = best_of_ms(5, [&]{ loop_val = sum_loop(1, 10'000'000); sink = loop_val; });
+    double t_cf = best_of_ms(5, [&]{ sink = SumRangeJob(1, 10'000'000).run().value; });
+    std::cout << "\nrange 1..1e7: loop " << std::fixed << std::setprecision(3) << t_loop
+              << " ms, closed form " << t_cf << " ms\n";
+
+    // Array reduction over random data, including negatives and an odd tail.
+    std::vector<std::int32_t> data(10'000'003);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<std::int32_t> dist(std::numeric_limits<std::int32_t>::min(),
+                                                     std::numeric_limits<std::int32_t>::max());
+    for (auto& x : data) x = dist(rng);
+
+    std::vector<simd::Kernel> kernels{{"scalar", simd::sum_scalar}};
+#if SUM_HAVE_X86
+    if (__builtin_cpu_supports("sse4.1")) kernels.push_back({"sse4.1", simd::sum_sse41});
+    if (__builtin_cpu_supports("avx2"))   kernels.push_back({"avx2", simd::sum_avx2});
+#endif
+    const std::int64_t expected = simd::sum_scalar(data.data(), data.size());
+    std::cout << "array of " << data.size() << " int32 (dispatch picks "
+              << simd::best().name << "):\n";
+    for (const auto& k : kernels) {
+        std::int64_t got = 0;
+        double t = best_of_ms(5, [&]{ got = k.fn(data.data(), data.size()); sink = got; });
+        std::cout << "  " << std::setw(7) << k.name << ": " << std::setw(8) << t << " ms "
+                  << std::setprecision(2) << (data.size() * sizeof(std::int32_t) / t / 1e6)
+                  << " GB/s" << std::setprecision(3)
+                  << (got == expected ? "" : "  MISMATCH") << "\n";
+    }
+    std::cout << "  ArraySumJob -> " << ArraySumJob(data.data(), data.size()).run().value << "\n";
+}
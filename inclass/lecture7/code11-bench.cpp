@@ -0,0 +1,1231 @@
+// pool_bench.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code11-bench.cpp -o code11
+// Run:
+//   ./code11                       # full matrix
+//   ./code11 --quick               # fewer configs, for a smoke run
+//   ./code11 --reps 5 --label v2 --out results/v2
+//
+// Benchmarks every pool in lecture7 on the same workloads:
+//   pools     : ThreadPool (code1), TSQueuePool (code2), WorkStealingPool (code3),
+//               RingPool (code4), InlineTaskPool (code5)
+//   job sizes : empty, 1us, 100us, 10ms (busy-spin, so it is CPU work)
+//   threads   : 1, 2, 4, 8 workers
+//   producers : 1 or 4 submitting threads
+// Each config runs warmup reps (discarded) then measured reps, and reports
+// throughput, submit->finish latency p50/p99/p999, and process CPU time.
+// Results go to stdout and to <out>.csv / <out>.json so runs can be diffed
+// (default bench_results.*, which git ignores).
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+constexpr std::size_t kCacheLine = 64;
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// ---------------- ThreadPool (single shared queue, as in code1) ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.emplace([pkg]{ (*pkg)(); });
+        }
+        cv_.notify_one();
+        return fut;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- WorkStealingPool (code3) ----------------
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(std::size_t n = std::thread::hardware_concurrency()) {
+        if (!n) n = 1;
+        queues_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            queues_.push_back(std::make_unique<WorkQueue>());
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            workers_.emplace_back([this, i]{ worker_loop(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Fire-and-forget
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit and get future
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        if (stop_.load(std::memory_order_acquire))
+            throw std::runtime_error("submit on stopped pool");
+        push([pkg]{ (*pkg)(); });
+        return fut;
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lk(idle_m_);
+            stop_.store(true, std::memory_order_release);
+        }
+        idle_cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    // One deque per worker. The lock is only ever shared between the owner
+    // and an occasional thief, so it is almost always uncontended.
+    struct WorkQueue {
+        std::mutex m;
+        std::deque<std::function<void()>> dq;
+    };
+
+    void push(std::function<void()> task) {
+        std::size_t idx;
+        if (tls_pool_ == this) {
+            idx = tls_index_;                                   // stay local
+        } else {
+            idx = next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        }
+        {
+            std::lock_guard<std::mutex> lk(queues_[idx]->m);
+            queues_[idx]->dq.push_back(std::move(task));
+        }
+        pending_.fetch_add(1, std::memory_order_release);
+        // Taking idle_m_ (empty critical section) closes the window between a
+        // worker's "nothing pending" check and its cv wait.
+        { std::lock_guard<std::mutex> lk(idle_m_); }
+        idle_cv_.notify_one();
+    }
+
+    bool pop_local(std::size_t i, std::function<void()>& out) {
+        WorkQueue& wq = *queues_[i];
+        std::lock_guard<std::mutex> lk(wq.m);
+        if (wq.dq.empty()) return false;
+        out = std::move(wq.dq.back());
+        wq.dq.pop_back();
+        return true;
+    }
+
+    bool steal(std::size_t thief, std::function<void()>& out) {
+        const std::size_t n = queues_.size();
+        for (std::size_t k = 1; k < n; ++k) {
+            WorkQueue& wq = *queues_[(thief + k) % n];
+            std::unique_lock<std::mutex> lk(wq.m, std::try_to_lock);
+            if (!lk.owns_lock() || wq.dq.empty()) continue;     // busy/empty: try next victim
+            out = std::move(wq.dq.front());
+            wq.dq.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void worker_loop(std::size_t i) {
+        tls_pool_ = this;
+        tls_index_ = i;
+        std::function<void()> task;
+        for (;;) {
+            if (pop_local(i, task) || steal(i, task)) {
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                try { task(); } catch (...) { /* swallow/log */ }
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(idle_m_);
+            idle_cv_.wait(lk, [this]{
+                return stop_.load(std::memory_order_relaxed) ||
+                       pending_.load(std::memory_order_acquire) > 0;
+            });
+            if (stop_.load(std::memory_order_relaxed) &&
+                pending_.load(std::memory_order_acquire) == 0) return;   // drained
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> next_{0};      // round-robin target for external submits
+    std::atomic<std::size_t> pending_{0};   // tasks pushed but not yet taken
+    std::atomic<bool> stop_{false};
+    std::mutex idle_m_;                     // only touched when a worker goes idle
+    std::condition_variable idle_cv_;
+
+    inline static thread_local WorkStealingPool* tls_pool_ = nullptr;
+    inline static thread_local std::size_t tls_index_ = 0;
+};
+
+// ---------------- TSQueue (thread-safe, closeable) ----------------
+template <class T>
+class TSQueue {
+public:
+    TSQueue() : closed_(false) {}
+
+    TSQueue(const TSQueue&) = delete;
+    TSQueue& operator=(const TSQueue&) = delete;
+
+    // Producers
+    bool push(const T& v) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (closed_) return false;
+        q_.push(v);
+        cv_.notify_one();
+        return true;
+    }
+    bool push(T&& v) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (closed_) return false;
+        q_.push(std::move(v));
+        cv_.notify_one();
+        return true;
+    }
+    template<class... Args>
+    bool emplace(Args&&... args) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (closed_) return false;
+        q_.emplace(std::forward<Args>(args)...);
+        cv_.notify_one();
+        return true;
+    }
+
+    // Consumers
+    bool try_pop(T& out) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (q_.empty()) return false;
+        out = std::move(q_.front());
+        q_.pop();
+        return true;
+    }
+
+    // Blocks until item available OR queue is closed & drained.
+    // Returns false only when closed and empty.
+    bool wait_pop(T& out) {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [this]{ return closed_ || !q_.empty(); });
+        if (q_.empty()) return false; // closed and drained
+        out = std::move(q_.front());
+        q_.pop();
+        return true;
+    }
+
+    // Shutdown producers and wake all consumers.
+    void close() {
+        std::lock_guard<std::mutex> lk(m_);
+        closed_ = true;
+        cv_.notify_all();
+    }
+
+    bool closed() const {
+        std::lock_guard<std::mutex> lk(m_);
+        return closed_;
+    }
+
+    bool empty() const {
+        std::lock_guard<std::mutex> lk(m_);
+        return q_.empty();
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lk(m_);
+        return q_.size();
+    }
+
+private:
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    std::queue<T> q_;
+    bool closed_;
+};
+
+// ---------------- TSQueuePool (ThreadPool using TSQueue, code2) ----------------
+class TSQueuePool {
+public:
+    explicit TSQueuePool(std::size_t n = std::thread::hardware_concurrency()) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this]{
+                std::function<void()> task;
+                while (tasks_.wait_pop(task)) {
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    // Fire-and-forget
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit and get future
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        if (!tasks_.emplace([pkg]{ (*pkg)(); })) {
+            throw std::runtime_error("submit on stopped pool");
+        }
+        return fut;
+    }
+
+    // Optional explicit stop if you want to end before destruction.
+    void shutdown() {
+        tasks_.close();
+    }
+
+    ~TSQueuePool() {
+        tasks_.close(); // signal shutdown
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    TSQueue<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+};
+
+// ---------------- RingQueue (bounded, lock-free MPMC; code4) ----------------
+template <class T>
+class RingQueue {
+public:
+    // capacity is rounded up to a power of two.
+    // spin_limit: how many failed attempts a waiter makes before parking
+    // (0 = park immediately, like TSQueue). Spinning on a single core only
+    // delays the thread we are waiting for, so it is disabled there.
+    explicit RingQueue(std::size_t capacity = 1024, std::size_t spin_limit = 256)
+    : spin_limit_(std::thread::hardware_concurrency() > 1 ? spin_limit : 0) {
+        std::size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        cells_.reset(new Cell[cap]);
+        for (std::size_t i = 0; i < cap; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    ~RingQueue() {
+        T tmp;
+        while (try_pop(tmp)) {}                 // destroy anything left behind
+    }
+
+    // Producers: block while full, return false once closed.
+    bool push(const T& v) { return emplace(v); }
+    bool push(T&& v)      { return emplace(std::move(v)); }
+
+    template<class... Args>
+    bool emplace(Args&&... args) {
+        ProducerGuard g(*this);
+        if (closed_.load(std::memory_order_seq_cst)) return false;
+        for (std::size_t spin = 0; ; ++spin) {
+            if (try_emplace_impl(std::forward<Args>(args)...)) {
+                wake(empty_waiters_, not_empty_);
+                return true;
+            }
+            if (closed_.load(std::memory_order_relaxed)) return false;
+            if (spin < spin_limit_) { cpu_relax(); continue; }
+
+            // Park until a consumer frees a slot (or we are closed).
+            std::unique_lock<std::mutex> lk(park_m_);
+            full_waiters_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool ok = false;
+            not_full_.wait(lk, [&]{
+                ok = try_emplace_impl(std::forward<Args>(args)...);
+                return ok || closed_.load(std::memory_order_relaxed);
+            });
+            full_waiters_.fetch_sub(1, std::memory_order_relaxed);
+            lk.unlock();
+            if (ok) wake(empty_waiters_, not_empty_);
+            return ok;
+        }
+    }
+
+    // Non-blocking producer: false if full or closed.
+    bool try_push(T&& v) {
+        ProducerGuard g(*this);
+        if (closed_.load(std::memory_order_seq_cst)) return false;
+        if (!try_emplace_impl(std::move(v))) return false;
+        wake(empty_waiters_, not_empty_);
+        return true;
+    }
+
+    // Consumers
+    bool try_pop(T& out) {
+        if (!try_pop_impl(out)) return false;
+        wake(full_waiters_, not_full_);
+        return true;
+    }
+
+    // Blocks until item available OR queue is closed & drained.
+    // Returns false only when closed and empty.
+    bool wait_pop(T& out) {
+        for (std::size_t spin = 0; ; ++spin) {
+            if (try_pop(out)) return true;
+            if (drained()) return false;
+            if (spin < spin_limit_) { cpu_relax(); continue; }
+
+            std::unique_lock<std::mutex> lk(park_m_);
+            empty_waiters_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool ok = false, done = false;
+            not_empty_.wait(lk, [&]{
+                ok = try_pop_impl(out);
+                done = !ok && drained();
+                return ok || done;
+            });
+            empty_waiters_.fetch_sub(1, std::memory_order_relaxed);
+            lk.unlock();
+            if (ok) { wake(full_waiters_, not_full_); return true; }
+            if (done) return false;
+        }
+    }
+
+    // Shutdown producers and wake all waiters.
+    void close() {
+        closed_.store(true, std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lk(park_m_);
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    // Approximate under concurrency, exact when quiescent.
+    std::size_t size() const {
+        std::size_t t = tail_.load(std::memory_order_acquire);
+        std::size_t h = head_.load(std::memory_order_acquire);
+        return t > h ? t - h : 0;
+    }
+    bool empty() const { return size() == 0; }
+    std::size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct alignas(kCacheLine) Cell {
+        std::atomic<std::size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+        T* ptr() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    // Counts producers between "checked closed_" and "published the item",
+    // so consumers never report drained while a push is still landing.
+    struct ProducerGuard {
+        explicit ProducerGuard(RingQueue& q) : q_(q) {
+            q_.producers_.fetch_add(1, std::memory_order_seq_cst);
+        }
+        ~ProducerGuard() {
+            if (q_.producers_.fetch_sub(1, std::memory_order_seq_cst) == 1 &&
+                q_.closed_.load(std::memory_order_seq_cst))
+                q_.wake_all(q_.not_empty_);
+        }
+        RingQueue& q_;
+    };
+
+    template<class... Args>
+    bool try_emplace_impl(Args&&... args) {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells_[pos & mask_];
+            std::size_t seq = c.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    ::new (static_cast<void*>(c.storage)) T(std::forward<Args>(args)...);
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;                   // full
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop_impl(T& out) {
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells_[pos & mask_];
+            std::size_t seq = c.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* p = c.ptr();
+                    out = std::move(*p);
+                    p->~T();
+                    c.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;                   // empty
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool drained() const {
+        return closed_.load(std::memory_order_seq_cst) &&
+               producers_.load(std::memory_order_seq_cst) == 0 &&
+               empty();
+    }
+
+    // Never called with park_m_ held.
+    // Fast path is a single load: no waiter, no mutex, no syscall.
+    void wake(std::atomic<int>& waiters, std::condition_variable& cv) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0) return;
+        std::lock_guard<std::mutex> lk(park_m_);
+        cv.notify_one();
+    }
+    void wake_all(std::condition_variable& cv) {
+        std::lock_guard<std::mutex> lk(park_m_);
+        cv.notify_all();
+    }
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_ = 0;
+    std::size_t spin_limit_;
+
+    alignas(kCacheLine) std::atomic<std::size_t> tail_{0};   // producers' ticket
+    alignas(kCacheLine) std::atomic<std::size_t> head_{0};   // consumers' ticket
+    alignas(kCacheLine) std::atomic<bool> closed_{false};
+    std::atomic<int> producers_{0};
+    std::atomic<int> empty_waiters_{0};
+    std::atomic<int> full_waiters_{0};
+    std::mutex park_m_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+// ---------------- RingPool (ThreadPool over RingQueue, code4) ----------------
+template <template<class> class Queue>
+class BasicThreadPool {
+public:
+    template<class... QueueArgs>
+    explicit BasicThreadPool(std::size_t n, QueueArgs&&... qargs)
+    : tasks_(std::forward<QueueArgs>(qargs)...) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this]{
+                std::function<void()> task;
+                while (tasks_.wait_pop(task)) {
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        if (!tasks_.emplace([pkg]{ (*pkg)(); })) {
+            throw std::runtime_error("submit on stopped pool");
+        }
+        return fut;
+    }
+
+    void shutdown() {
+        tasks_.close();
+    }
+
+    ~BasicThreadPool() {
+        tasks_.close(); // signal shutdown
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    Queue<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+};
+
+using RingPool = BasicThreadPool<RingQueue>;
+
+// ---------------- InlineTask (code5) ----------------
+class InlineTask {
+public:
+    static constexpr std::size_t kInlineSize = 64;
+
+    InlineTask() noexcept = default;
+
+    template<class F, class D = std::decay_t<F>,
+             class = std::enable_if_t<!std::is_same<D, InlineTask>::value>>
+    InlineTask(F&& f) {
+        if constexpr (fits_inline<D>()) {
+            ::new (static_cast<void*>(buf_)) D(std::forward<F>(f));
+            vt_ = &inline_vtable<D>;
+        } else {
+            ::new (static_cast<void*>(buf_)) D*(new D(std::forward<F>(f)));
+            vt_ = &heap_vtable<D>;
+        }
+    }
+
+    InlineTask(InlineTask&& o) noexcept : vt_(o.vt_) {
+        if (vt_) { vt_->move(buf_, o.buf_); o.vt_ = nullptr; }
+    }
+    InlineTask& operator=(InlineTask&& o) noexcept {
+        if (this != &o) {
+            reset();
+            vt_ = o.vt_;
+            if (vt_) { vt_->move(buf_, o.buf_); o.vt_ = nullptr; }
+        }
+        return *this;
+    }
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    ~InlineTask() { reset(); }
+
+    explicit operator bool() const noexcept { return vt_ != nullptr; }
+    void operator()() { vt_->invoke(buf_); }
+
+    void reset() noexcept {
+        if (vt_) { vt_->destroy(buf_); vt_ = nullptr; }
+    }
+
+private:
+    struct VTable {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src) noexcept;    // move-construct dst, destroy src
+        void (*destroy)(void*) noexcept;
+    };
+
+    template<class D>
+    static constexpr bool fits_inline() {
+        return sizeof(D) <= kInlineSize &&
+               alignof(D) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<D>::value;
+    }
+
+    template<class D>
+    static constexpr VTable inline_vtable = {
+        [](void* p) { (*static_cast<D*>(p))(); },
+        [](void* dst, void* src) noexcept {
+            ::new (dst) D(std::move(*static_cast<D*>(src)));
+            static_cast<D*>(src)->~D();
+        },
+        [](void* p) noexcept { static_cast<D*>(p)->~D(); },
+    };
+
+    template<class D>
+    static constexpr VTable heap_vtable = {
+        [](void* p) { (**static_cast<D**>(p))(); },
+        [](void* dst, void* src) noexcept {
+            ::new (dst) D*(*static_cast<D**>(src));
+        },
+        [](void* p) noexcept { delete *static_cast<D**>(p); },
+    };
+
+    alignas(std::max_align_t) unsigned char buf_[kInlineSize];
+    const VTable* vt_ = nullptr;
+};
+
+// ---------------- TaskPromise / TaskFuture ----------------
+namespace detail {
+
+struct Unit {};
+
+template<class R>
+class SharedState {
+public:
+    using Stored = std::conditional_t<std::is_void<R>::value, Unit, R>;
+
+    // States are recycled: each thread keeps a small free list, and spills to or
+    // refills from a shared list in batches. Promises are usually released on
+    // a worker and futures on the submitter, so states migrate between threads
+    // and the shared list is what keeps the submitter from allocating.
+    static SharedState* acquire() {
+        FreeList& fl = local_list();
+        if (!fl.head) refill(fl);
+        SharedState* s = fl.pop();
+        if (!s) s = new SharedState();
+        s->refs_.store(2, std::memory_order_relaxed);   // one promise + one future
+        s->ready_ = false;
+        return s;
+    }
+
+    void release() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        value_.reset();
+        error_ = nullptr;
+        FreeList& fl = local_list();
+        fl.push(this);
+        if (fl.size >= 2 * kBatch) spill(fl);
+    }
+
+    template<class... V>
+    void set_value(V&&... v) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            value_.emplace(std::forward<V>(v)...);
+            ready_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    void set_exception(std::exception_ptr e) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            error_ = std::move(e);
+            ready_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [this]{ return ready_; });
+    }
+
+    bool is_ready() {
+        std::lock_guard<std::mutex> lk(m_);
+        return ready_;
+    }
+
+    Stored take() {
+        wait();
+        if (error_) std::rethrow_exception(error_);
+        return std::move(*value_);
+    }
+
+private:
+    static constexpr std::size_t kBatch = 64;
+
+    struct FreeList {
+        SharedState* head = nullptr;
+        std::size_t size = 0;
+
+        void push(SharedState* s) { s->next_free_ = head; head = s; ++size; }
+        SharedState* pop() {
+            SharedState* s = head;
+            if (s) { head = s->next_free_; --size; }
+            return s;
+        }
+        ~FreeList() {
+            while (SharedState* s = pop()) delete s;
+        }
+    };
+
+    static FreeList& local_list() {
+        static thread_local FreeList fl;
+        return fl;
+    }
+
+    struct GlobalList {
+        std::mutex m;
+        FreeList list;
+    };
+    static GlobalList& global_list() {
+        static GlobalList gl;
+        return gl;
+    }
+
+    static void refill(FreeList& fl) {
+        GlobalList& gl = global_list();
+        std::lock_guard<std::mutex> lk(gl.m);
+        for (std::size_t i = 0; i < kBatch; ++i) {
+            SharedState* s = gl.list.pop();
+            if (!s) break;
+            fl.push(s);
+        }
+    }
+
+    static void spill(FreeList& fl) {
+        GlobalList& gl = global_list();
+        std::lock_guard<std::mutex> lk(gl.m);
+        for (std::size_t i = 0; i < kBatch; ++i) gl.list.push(fl.pop());
+    }
+
+    std::atomic<int> refs_{0};
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool ready_ = false;
+    std::optional<Stored> value_;
+    std::exception_ptr error_;
+    SharedState* next_free_ = nullptr;
+};
+
+} // namespace detail
+
+template<class R>
+class TaskFuture {
+public:
+    TaskFuture() = default;
+    TaskFuture(TaskFuture&& o) noexcept : st_(std::exchange(o.st_, nullptr)) {}
+    TaskFuture& operator=(TaskFuture&& o) noexcept {
+        if (this != &o) { drop(); st_ = std::exchange(o.st_, nullptr); }
+        return *this;
+    }
+    ~TaskFuture() { drop(); }
+
+    bool valid() const noexcept { return st_ != nullptr; }
+    bool is_ready() const { return st_ && st_->is_ready(); }
+    void wait() const { st_->wait(); }
+
+    // One-shot, like std::future::get(): rethrows the job's exception.
+    R get() {
+        if (!st_) throw std::future_error(std::future_errc::no_state);
+        auto* st = std::exchange(st_, nullptr);
+        struct Release { detail::SharedState<R>* s; ~Release() { s->release(); } } rel{st};
+        if constexpr (std::is_void<R>::value) { st->take(); }
+        else                                  { return st->take(); }
+    }
+
+private:
+    template<class> friend class TaskPromise;
+    explicit TaskFuture(detail::SharedState<R>* st) : st_(st) {}
+    void drop() { if (st_) { st_->release(); st_ = nullptr; } }
+
+    detail::SharedState<R>* st_ = nullptr;
+};
+
+template<class R>
+class TaskPromise {
+public:
+    TaskPromise() : st_(detail::SharedState<R>::acquire()) {}
+    TaskPromise(TaskPromise&& o) noexcept : st_(std::exchange(o.st_, nullptr)),
+                                            future_taken_(o.future_taken_) {}
+    TaskPromise& operator=(TaskPromise&&) = delete;
+    ~TaskPromise() {
+        if (!st_) return;
+        if (!satisfied_)
+            st_->set_exception(std::make_exception_ptr(
+                std::future_error(std::future_errc::broken_promise)));
+        if (!future_taken_) st_->release();             // nobody will release the future's ref
+        st_->release();
+    }
+
+    TaskFuture<R> get_future() {
+        future_taken_ = true;
+        return TaskFuture<R>(st_);
+    }
+
+    // Runs fn and stores its result or exception, like packaged_task::operator().
+    template<class Fn>
+    void run(Fn&& fn) {
+        try {
+            if constexpr (std::is_void<R>::value) { fn(); st_->set_value(); }
+            else                                  { st_->set_value(fn()); }
+        } catch (...) {
+            st_->set_exception(std::current_exception());
+        }
+        satisfied_ = true;
+    }
+
+private:
+    detail::SharedState<R>* st_;
+    bool future_taken_ = false;
+    bool satisfied_ = false;
+};
+
+// ---------------- InlineTaskPool (InlineTask ring, code5) ----------------
+class InlineTaskPool {
+public:
+    explicit InlineTaskPool(std::size_t n = std::thread::hardware_concurrency(),
+                        std::size_t initial_capacity = 1024)
+    : ring_(initial_capacity ? initial_capacity : 1) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    InlineTask task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || count_ != 0; });
+                        if (stop_ && count_ == 0) return;
+                        task = std::move(ring_[head_]);
+                        head_ = (head_ + 1) % ring_.size();
+                        --count_;
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    // Fire-and-forget: just ignore the returned future
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit and get a future result
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a) -> TaskFuture<std::invoke_result_t<F, A...>> {
+        using R = std::invoke_result_t<F, A...>;
+        TaskPromise<R> p;
+        auto fut = p.get_future();
+        push(InlineTask(
+            [p = std::move(p), fn = std::forward<F>(f),
+             args = std::make_tuple(std::forward<A>(a)...)]() mutable {
+                p.run([&]() -> R { return std::apply(fn, std::move(args)); });
+            }));
+        return fut;
+    }
+
+    ~InlineTaskPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    void push(InlineTask task) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            if (count_ == ring_.size()) grow();
+            ring_[(head_ + count_) % ring_.size()] = std::move(task);
+            ++count_;
+        }
+        cv_.notify_one();
+    }
+
+    // Caller holds m_. Doubling keeps growth amortised; the ring never shrinks.
+    void grow() {
+        std::vector<InlineTask> bigger(ring_.size() * 2);
+        for (std::size_t i = 0; i < count_; ++i)
+            bigger[i] = std::move(ring_[(head_ + i) % ring_.size()]);
+        ring_.swap(bigger);
+        head_ = 0;
+    }
+
+    std::vector<std::thread> workers_;
+    std::vector<InlineTask> ring_;
+    std::size_t head_ = 0;
+    std::size_t count_ = 0;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+// ---------------- Harness ----------------
+using clock_type = std::chrono::steady_clock;
+
+struct Workload {
+    const char* name;
+    std::chrono::nanoseconds job;
+};
+
+struct Config {
+    std::string pool;
+    std::string workload;
+    std::size_t threads;
+    std::size_t producers;
+    std::size_t jobs;
+};
+
+struct Result {
+    Config cfg;
+    double throughput = 0;      // jobs per second, mean over reps
+    double p50_us = 0, p99_us = 0, p999_us = 0;
+    double cpu_ms = 0;          // process CPU time per rep, mean
+    double wall_ms = 0;         // wall time per rep, mean
+};
+
+struct Options {
+    int warmup = 1;
+    int reps = 3;
+    bool quick = false;
+    std::string label = "current";
+    std::string out = "bench_results";
+};
+
+void spin_for(std::chrono::nanoseconds d) {
+    if (d.count() == 0) return;
+    auto end = clock_type::now() + d;
+    while (clock_type::now() < end) {}
+}
+
+double cpu_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Enough jobs for ~200ms of total work, bounded so tiny jobs still finish fast.
+std::size_t jobs_for(std::chrono::nanoseconds job, bool quick) {
+    const std::int64_t budget_ns = quick ? 50'000'000 : 200'000'000;
+    std::int64_t n = job.count() ? budget_ns / job.count() : 200'000;
+    return static_cast<std::size_t>(std::clamp<std::int64_t>(n, 16, quick ? 20'000 : 200'000));
+}
+
+double percentile(std::vector<std::int64_t>& v, double q) {
+    if (v.empty()) return 0;
+    auto k = static_cast<std::size_t>(q * static_cast<double>(v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(k), v.end());
+    return v[k] / 1000.0;
+}
+
+// One rep: `producers` threads split `jobs` submissions; every job records
+// its own submit->finish latency. Returns wall and CPU time for the rep.
+template<class Pool>
+std::pair<double, double> run_once(Pool& pool, const Config& cfg, std::chrono::nanoseconds job,
+                                   std::vector<std::int64_t>& latencies) {
+    std::vector<std::int64_t> lat(cfg.jobs);
+    std::atomic<std::size_t> remaining{cfg.jobs};
+    std::promise<void> done;
+    auto done_fut = done.get_future();
+
+    double cpu0 = cpu_seconds();
+    auto t0 = clock_type::now();
+    std::vector<std::thread> producers;
+    for (std::size_t p = 0; p < cfg.producers; ++p) {
+        producers.emplace_back([&, p]{
+            for (std::size_t i = p; i < cfg.jobs; i += cfg.producers) {
+                auto submitted = clock_type::now();
+                pool.enqueue([&, i, submitted]{
+                    spin_for(job);
+                    lat[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 clock_type::now() - submitted).count();
+                    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) done.set_value();
+                });
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    done_fut.wait();
+    auto t1 = clock_type::now();
+    double cpu1 = cpu_seconds();
+
+    latencies.insert(latencies.end(), lat.begin(), lat.end());
+    return {std::chrono::duration<double, std::milli>(t1 - t0).count(), (cpu1 - cpu0) * 1000.0};
+}
+
+template<class Pool>
+Result run_config(const Config& cfg, std::chrono::nanoseconds job, const Options& opt) {
+    Pool pool(cfg.threads);
+    std::vector<std::int64_t> scratch, latencies;
+    for (int w = 0; w < opt.warmup; ++w) run_once(pool, cfg, job, scratch);
+
+    Result r;
+    r.cfg = cfg;
+    for (int rep = 0; rep < opt.reps; ++rep) {
+        auto [wall, cpu] = run_once(pool, cfg, job, latencies);
+        r.wall_ms += wall / opt.reps;
+        r.cpu_ms += cpu / opt.reps;
+        r.throughput += cfg.jobs / (wall / 1000.0) / opt.reps;
+    }
+    r.p50_us = percentile(latencies, 0.50);
+    r.p99_us = percentile(latencies, 0.99);
+    r.p999_us = percentile(latencies, 0.999);
+    return r;
+}
+
+void print_header() {
+    std::cout << std::left << std::setw(18) << "pool" << std::setw(7) << "job"
+              << std::right << std::setw(4) << "thr" << std::setw(5) << "prod"
+              << std::setw(8) << "jobs" << std::setw(14) << "jobs/s"
+              << std::setw(11) << "p50(us)" << std::setw(11) << "p99(us)"
+              << std::setw(11) << "p999(us)" << std::setw(10) << "cpu(ms)" << "\n";
+}
+
+void print_row(const Result& r) {
+    std::cout << std::left << std::setw(18) << r.cfg.pool << std::setw(7) << r.cfg.workload
+              << std::right << std::setw(4) << r.cfg.threads << std::setw(5) << r.cfg.producers
+              << std::setw(8) << r.cfg.jobs << std::fixed << std::setprecision(0)
+              << std::setw(14) << r.throughput << std::setprecision(1)
+              << std::setw(11) << r.p50_us << std::setw(11) << r.p99_us
+              << std::setw(11) << r.p999_us << std::setw(10) << r.cpu_ms << "\n"
+              << std::defaultfloat;
+}
+
+void write_csv(const std::string& path, const std::string& label, const std::vector<Result>& rs) {
+    std::ofstream out(path);
+    out << "label,pool,job,threads,producers,jobs,throughput,p50_us,p99_us,p999_us,cpu_ms,wall_ms\n";
+    for (const auto& r : rs)
+        out << label << ',' << r.cfg.pool << ',' << r.cfg.workload << ',' << r.cfg.threads << ','
+            << r.cfg.producers << ',' << r.cfg.jobs << ',' << r.throughput << ','
+            << r.p50_us << ',' << r.p99_us << ',' << r.p999_us << ','
+            << r.cpu_ms << ',' << r.wall_ms << '\n';
+}
+
+void write_json(const std::string& path, const std::string& label, const Options& opt,
+                const std::vector<Result>& rs) {
+    std::ofstream out(path);
+    out << "{\n  \"label\": \"" << label << "\",\n"
+        << "  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"warmup\": " << opt.warmup << ",\n  \"reps\": " << opt.reps << ",\n"
+        << "  \"results\": [\n";
+    for (std::size_t i = 0; i < rs.size(); ++i) {
+        const Result& r = rs[i];
+        out << "    {\"pool\": \"" << r.cfg.pool << "\", \"job\": \"" << r.cfg.workload
+            << "\", \"threads\": " << r.cfg.threads << ", \"producers\": " << r.cfg.producers
+            << ", \"jobs\": " << r.cfg.jobs << ", \"throughput\": " << r.throughput
+            << ", \"p50_us\": " << r.p50_us << ", \"p99_us\": " << r.p99_us
+            << ", \"p999_us\": " << r.p999_us << ", \"cpu_ms\": " << r.cpu_ms
+            << ", \"wall_ms\": " << r.wall_ms << "}" << (i + 1 < rs.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+Options parse(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) { std::cerr << a << " needs a value\n"; std::exit(2); }
+            return argv[++i];
+        };
+        if (a == "--quick")       opt.quick = true;
+        else if (a == "--reps")   opt.reps = std::max(1, std::atoi(next().c_str()));
+        else if (a == "--warmup") opt.warmup = std::max(0, std::atoi(next().c_str()));
+        else if (a == "--label")  opt.label = next();
+        else if (a == "--out")    opt.out = next();
+        else { std::cerr << "unknown option " << a << "\n"; std::exit(2); }
+    }
+    return opt;
+}
+
+int main(int argc, char** argv) {
+    using namespace std::chrono_literals;
+    Options opt = parse(argc, argv);
+
+    std::vector<Workload> workloads{{"empty", 0ns}, {"1us", 1us}, {"100us", 100us}, {"10ms", 10ms}};
+    std::vector<std::size_t> thread_counts{1, 2, 4, 8};
+    std::vector<std::size_t> producer_counts{1, 4};
+    if (opt.quick) {
+        workloads = {{"empty", 0ns}, {"100us", 100us}};
+        thread_counts = {1, 4};
+        producer_counts = {1};
+    }
+
+    std::vector<Result> results;
+    print_header();
+    for (const auto& w : workloads)
+        for (std::size_t threads : thread_counts)
+            for (std::size_t producers : producer_counts) {
+                const std::size_t jobs = jobs_for(w.job, opt.quick);
+                Config cfg{"", w.name, threads, producers, jobs};
+                cfg.pool = "ThreadPool";
+                results.push_back(run_config<ThreadPool>(cfg, w.job, opt));
+                print_row(results.back());
+                cfg.pool = "TSQueuePool";
+                results.push_back(run_config<TSQueuePool>(cfg, w.job, opt));
+                print_row(results.back());
+                cfg.pool = "WorkStealingPool";
+                results.push_back(run_config<WorkStealingPool>(cfg, w.job, opt));
+                print_row(results.back());
+                cfg.pool = "RingPool";
+                results.push_back(run_config<RingPool>(cfg, w.job, opt));
+                print_row(results.back());
+                cfg.pool = "InlineTaskPool";
+                results.push_back(run_config<InlineTaskPool>(cfg, w.job, opt));
+                print_row(results.back());
+            }
+
+    write_csv(opt.out + ".csv", opt.label, results);
+    write_json(opt.out + ".json", opt.label, opt, results);
+    std::cout << "wrote " << opt.out << ".csv and " << opt.out << ".json\n";
+}
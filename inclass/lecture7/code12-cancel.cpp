@@ -0,0 +1,484 @@
+// cancel_deadline_pool.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code12-cancel.cpp -o code12
+//
+// code2's TSQueue pool with cooperative cancellation (README Phase 6):
+//   CancellationSource / CancellationToken : request_stop() / stop_requested()
+//   submit(TaskOptions{token, deadline}, f, args...)
+// A queued task whose token is stopped, or whose deadline passes, is dropped
+// without running and its future throws TaskCancelled / DeadlineExceeded at
+// once: a CancellationCallback on the token and the pool's DeadlineTimer
+// settle it eagerly, and the worker that later dequeues it finds it settled.
+// The dequeue-time check stays as the fallback. Running jobs poll
+// token.stop_requested() (one atomic load per level) and return early.
+// shutdown_now() cancels everything still queued instead of draining it.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ---------------- Cancellation ----------------
+class CancellationToken {
+public:
+    CancellationToken() = default;        // never cancelled
+
+    // True once this token's source, or any parent source, requested stop.
+    bool stop_requested() const noexcept {
+        for (const State* s = state_.get(); s; s = s->parent.get())
+            if (s->stopped.load(std::memory_order_acquire)) return true;
+        return false;
+    }
+
+private:
+    friend class CancellationSource;
+    friend class CancellationCallback;
+
+    // Runs its function at most once; lets the owner wait out a run in progress.
+    struct Once {
+        std::function<void()> fn;
+        std::atomic<int> state{0};                  // 0 idle, 1 running, 2 done
+        std::atomic<std::thread::id> runner{};
+
+        void operator()() noexcept {
+            int idle = 0;
+            if (!state.compare_exchange_strong(idle, 1, std::memory_order_acq_rel)) return;
+            runner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            try { fn(); } catch (...) { /* swallow/log */ }
+            state.store(2, std::memory_order_release);
+        }
+    };
+
+    struct State {
+        std::atomic<bool> stopped{false};
+        std::shared_ptr<State> parent;
+        std::mutex m;                               // guards callbacks and next_id
+        std::map<std::uint64_t, std::shared_ptr<Once>> callbacks;
+        std::uint64_t next_id = 0;
+    };
+    explicit CancellationToken(std::shared_ptr<State> s) : state_(std::move(s)) {}
+
+    std::shared_ptr<State> state_;
+};
+
+class CancellationSource {
+public:
+    CancellationSource() : state_(std::make_shared<State>()) {}
+
+    // Linked source: also stops when `parent` stops.
+    explicit CancellationSource(const CancellationToken& parent)
+    : state_(std::make_shared<State>()) {
+        state_->parent = parent.state_;
+    }
+
+    // Runs the callbacks registered on this source's tokens (and on tokens of
+    // sources linked to it) on the calling thread.
+    void request_stop() noexcept {
+        std::map<std::uint64_t, std::shared_ptr<CancellationToken::Once>> cbs;
+        {
+            std::lock_guard<std::mutex> lk(state_->m);
+            if (state_->stopped.load(std::memory_order_relaxed)) return;
+            state_->stopped.store(true, std::memory_order_release);
+            cbs.swap(state_->callbacks);
+        }
+        for (auto& [id, cb] : cbs) (*cb)();
+    }
+    bool stop_requested() const noexcept { return token().stop_requested(); }
+    CancellationToken token() const { return CancellationToken(state_); }
+
+private:
+    using State = CancellationToken::State;
+    std::shared_ptr<State> state_;
+};
+
+// Calls fn once when the token (or any parent) is stopped; at once if it
+// already is. fn runs on the thread that calls request_stop(). The
+// destructor deregisters fn, waiting for it if it is running elsewhere.
+class CancellationCallback {
+public:
+    CancellationCallback(const CancellationToken& tok, std::function<void()> fn)
+    : once_(std::make_shared<CancellationToken::Once>()) {
+        once_->fn = std::move(fn);
+        for (auto s = tok.state_; s; s = s->parent) {
+            std::unique_lock<std::mutex> lk(s->m);
+            if (s->stopped.load(std::memory_order_relaxed)) {
+                lk.unlock();
+                (*once_)();
+                return;
+            }
+            std::uint64_t id = s->next_id++;
+            s->callbacks.emplace(id, once_);
+            regs_.emplace_back(s, id);
+        }
+    }
+
+    CancellationCallback(const CancellationCallback&) = delete;
+    CancellationCallback& operator=(const CancellationCallback&) = delete;
+
+    ~CancellationCallback() {
+        for (auto& [s, id] : regs_) {
+            std::lock_guard<std::mutex> lk(s->m);
+            s->callbacks.erase(id);
+        }
+        if (once_->state.load(std::memory_order_acquire) == 1 &&
+            once_->runner.load(std::memory_order_relaxed) != std::this_thread::get_id())
+            while (once_->state.load(std::memory_order_acquire) != 2) std::this_thread::yield();
+    }
+
+private:
+    std::shared_ptr<CancellationToken::Once> once_;
+    std::vector<std::pair<std::shared_ptr<CancellationToken::State>, std::uint64_t>> regs_;
+};
+
+class TaskCancelled : public std::runtime_error {
+public:
+    TaskCancelled() : std::runtime_error("task cancelled before it ran") {}
+    explicit TaskCancelled(const std::string& what) : std::runtime_error(what) {}
+};
+
+class DeadlineExceeded : public TaskCancelled {
+public:
+    DeadlineExceeded() : TaskCancelled("task deadline passed before it ran") {}
+};
+
+struct TaskOptions {
+    using clock_type = std::chrono::steady_clock;
+    CancellationToken token;
+    clock_type::time_point deadline = clock_type::time_point::max();
+};
+
+// ---------------- TSQueue (thread-safe, closeable; as in code2) ----------------
+template <class T>
+class TSQueue {
+public:
+    TSQueue() : closed_(false) {}
+
+    TSQueue(const TSQueue&) = delete;
+    TSQueue& operator=(const TSQueue&) = delete;
+
+    template<class... Args>
+    bool emplace(Args&&... args) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (closed_) return false;
+            q_.emplace(std::forward<Args>(args)...);
+        }
+        cv_.notify_one();
+        return true;
+    }
+
+    // Blocks until item available OR queue is closed & drained.
+    bool wait_pop(T& out) {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [this]{ return closed_ || !q_.empty(); });
+        if (q_.empty()) return false; // closed and drained
+        out = std::move(q_.front());
+        q_.pop();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            closed_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    // Removes and returns everything still queued.
+    std::queue<T> take_all() {
+        std::queue<T> out;
+        std::lock_guard<std::mutex> lk(m_);
+        out.swap(q_);
+        return out;
+    }
+
+private:
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    std::queue<T> q_;
+    bool closed_;
+};
+
+// ---------------- DeadlineTimer ----------------
+// One thread that runs callbacks when their deadlines pass. cancel() drops a
+// callback that is no longer needed (a no-op if it already ran).
+class DeadlineTimer {
+public:
+    using clock_type = std::chrono::steady_clock;
+    using Key = std::pair<clock_type::time_point, std::uint64_t>;
+
+    DeadlineTimer() : thread_([this]{ loop(); }) {}
+
+    DeadlineTimer(const DeadlineTimer&) = delete;
+    DeadlineTimer& operator=(const DeadlineTimer&) = delete;
+
+    Key schedule(clock_type::time_point when, std::function<void()> fn) {
+        Key k;
+        bool earliest;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            k = {when, next_id_++};
+            earliest = due_.empty() || k < due_.begin()->first;
+            due_.emplace(k, std::move(fn));
+        }
+        if (earliest) cv_.notify_one();
+        return k;
+    }
+
+    void cancel(const Key& k) {
+        std::lock_guard<std::mutex> lk(m_);
+        due_.erase(k);
+    }
+
+    ~DeadlineTimer() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+private:
+    void loop() {
+        std::unique_lock<std::mutex> lk(m_);
+        while (!stop_) {
+            if (due_.empty()) { cv_.wait(lk); continue; }
+            auto it = due_.begin();
+            if (clock_type::now() < it->first.first) { cv_.wait_until(lk, it->first.first); continue; }
+            std::function<void()> fn = std::move(it->second);
+            due_.erase(it);
+            lk.unlock();
+            try { fn(); } catch (...) { /* swallow/log */ }
+            lk.lock();
+        }
+    }
+
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::map<Key, std::function<void()>> due_;
+    std::uint64_t next_id_ = 0;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+// ---------------- ThreadPool with cancellation ----------------
+class ThreadPool {
+public:
+    using clock_type = TaskOptions::clock_type;
+
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency()) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this]{
+                std::function<void()> task;
+                while (tasks_.wait_pop(task)) {
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    // Fire-and-forget
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit without a token or deadline (only shutdown_now() can drop it)
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        return submit(TaskOptions{}, std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit with a cancellation token and/or deadline
+    template<class F, class... A>
+    auto submit(TaskOptions opts, F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto p = std::make_shared<Pending<R>>();
+        auto fut = p->prom.get_future();
+        auto fn = std::bind(std::forward<F>(f), std::forward<A>(a)...);
+        auto pool_token = pool_stop_.token();
+
+        // Settle the future as soon as the token stops or the deadline
+        // passes, not when a worker gets to the task.
+        auto on_stop = std::make_shared<CancellationCallback>(opts.token, [this, p]{
+            if (p->claim()) fail<TaskCancelled>(p->prom, cancelled_);
+        });
+        const bool timed = opts.deadline != clock_type::time_point::max();
+        DeadlineTimer::Key timer_key{};
+        if (timed)
+            timer_key = timer_.schedule(opts.deadline, [this, w = std::weak_ptr<Pending<R>>(p)]{
+                if (auto p = w.lock(); p && p->claim()) fail<DeadlineExceeded>(p->prom, expired_);
+            });
+
+        bool ok = tasks_.emplace(
+            [this, p, fn = std::move(fn), opts = std::move(opts), pool_token, on_stop, timed, timer_key]() mutable {
+                on_stop.reset();
+                if (timed) timer_.cancel(timer_key);
+                if (!p->claim()) return;                    // already cancelled or expired
+                if (opts.token.stop_requested() || pool_token.stop_requested()) {
+                    fail<TaskCancelled>(p->prom, cancelled_);
+                    return;
+                }
+                if (clock_type::now() > opts.deadline) {
+                    fail<DeadlineExceeded>(p->prom, expired_);
+                    return;
+                }
+                try {
+                    if constexpr (std::is_void<R>::value) { fn(); p->prom.set_value(); }
+                    else                                  { p->prom.set_value(fn()); }
+                } catch (...) {
+                    p->prom.set_exception(std::current_exception());
+                }
+            });
+        if (!ok) {
+            if (timed) timer_.cancel(timer_key);
+            throw std::runtime_error("submit on stopped pool");
+        }
+        return fut;
+    }
+
+    // Token that stops when shutdown_now() is called; long jobs can poll it,
+    // or link their own source to it.
+    CancellationToken token() const { return pool_stop_.token(); }
+
+    // Graceful: run everything already queued, then stop.
+    void shutdown() {
+        tasks_.close();
+    }
+
+    // Immediate: queued tasks complete with TaskCancelled without running,
+    // running tasks see token().stop_requested().
+    void shutdown_now() {
+        pool_stop_.request_stop();
+        tasks_.close();
+        // Settle the queued futures here rather than as workers free up;
+        // each task sees the pool token stopped and fails its promise.
+        for (auto rest = tasks_.take_all(); !rest.empty(); rest.pop()) {
+            try { rest.front()(); } catch (...) { /* swallow/log */ }
+        }
+    }
+
+    std::size_t cancelled_count() const { return cancelled_.load(std::memory_order_relaxed); }
+    std::size_t expired_count() const { return expired_.load(std::memory_order_relaxed); }
+
+    ~ThreadPool() {
+        tasks_.close(); // signal shutdown
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    // A task's promise, settled by whichever of worker, token callback and
+    // deadline timer claims it first.
+    template<class R>
+    struct Pending {
+        std::promise<R> prom;
+        std::atomic<bool> settled{false};
+        bool claim() { return !settled.exchange(true, std::memory_order_acq_rel); }
+    };
+
+    template<class E, class R>
+    static void fail(std::promise<R>& prom, std::atomic<std::size_t>& counter) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+        prom.set_exception(std::make_exception_ptr(E()));
+    }
+
+    CancellationSource pool_stop_;
+    std::atomic<std::size_t> cancelled_{0};
+    std::atomic<std::size_t> expired_{0};
+    DeadlineTimer timer_;
+    TSQueue<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+};
+
+// ---------------- Demo ----------------
+// Long-running job: works in 10ms slices and checks the token between them.
+std::string long_job(int id, CancellationToken tok) {
+    for (int step = 0; step < 20; ++step) {
+        if (tok.stop_requested())
+            return "job " + std::to_string(id) + " cancelled early at step " + std::to_string(step);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return "job " + std::to_string(id) + " finished";
+}
+
+template<class R>
+void report(std::future<R>& f) {
+    try {
+        R r = f.get();
+        std::cout << "  " << r << "\n";
+    } catch (const DeadlineExceeded& e) {
+        std::cout << "  deadline: " << e.what() << "\n";
+    } catch (const TaskCancelled& e) {
+        std::cout << "  cancelled: " << e.what() << "\n";
+    }
+}
+
+int main() {
+    using namespace std::chrono_literals;
+
+    std::cout << "[token] cancel a request while its jobs are queued\n";
+    {
+        ThreadPool pool(1);
+        CancellationSource request;
+        std::vector<std::future<std::string>> futs;
+        for (int i = 0; i < 4; ++i)
+            futs.push_back(pool.submit(TaskOptions{request.token()}, long_job, i, request.token()));
+        std::this_thread::sleep_for(50ms);      // job 0 is mid-way
+        request.request_stop();
+        for (auto& f : futs) report(f);
+        std::cout << "  dropped without running: " << pool.cancelled_count() << "\n";
+    }
+
+    std::cout << "[deadline] jobs stuck behind a slow one\n";
+    {
+        ThreadPool pool(1);
+        auto start = ThreadPool::clock_type::now();
+        auto slow = pool.submit([]{ std::this_thread::sleep_for(60ms); return std::string("slow done"); });
+        std::vector<std::future<std::string>> futs;
+        for (int i = 0; i < 3; ++i) {
+            TaskOptions opts;
+            opts.deadline = start + (i == 2 ? 500ms : 20ms);
+            futs.push_back(pool.submit(opts, [i]{ return "fast " + std::to_string(i) + " done"; }));
+        }
+        futs[0].wait();
+        std::cout << "  fast 0 settled after "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(ThreadPool::clock_type::now() - start).count()
+                  << " ms, while the slow job still runs\n";
+        report(slow);
+        for (auto& f : futs) report(f);
+        std::cout << "  expired: " << pool.expired_count() << "\n";
+    }
+
+    std::cout << "[shutdown_now] stop instead of draining\n";
+    {
+        ThreadPool pool(2);
+        std::vector<std::future<std::string>> futs;
+        for (int i = 0; i < 6; ++i) {
+            CancellationSource per_job(pool.token());     // stops with the pool
+            futs.push_back(pool.submit(long_job, i, per_job.token()));
+        }
+        std::this_thread::sleep_for(30ms);
+        pool.shutdown_now();
+        for (auto& f : futs) report(f);
+    }
+}
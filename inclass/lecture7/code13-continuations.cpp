@@ -0,0 +1,362 @@
+// pool_continuations.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code13-continuations.cpp -o code13
+//
+// lecture5/code5-homework.cpp collects results by polling wait_for(0ms) and
+// sleeping 1ms between rounds. Here the pool returns PoolFuture<T>, whose
+// shared state keeps a list of callbacks run the moment the value is set:
+//   f.then(fn)         : fn(value) is scheduled on the pool when f is ready
+//   when_all(futs)     : ready when every input is ready (vector of values)
+//   when_any(futs)     : ready when the first input is ready (index + value)
+// Nothing polls, and no thread is parked in get() except main() at the end.
+// Like std::future, a PoolFuture is consumed by get() or then().
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ---------------- ThreadPool (queue part, as in code1) ----------------
+template<class T> class PoolFuture;
+
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    // Submit and get a PoolFuture (defined below, after PoolFuture)
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a) -> PoolFuture<std::invoke_result_t<F, A...>>;
+
+    // Queue a raw task. Returns false once the pool is stopping.
+    bool post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) return false;
+            q_.push(std::move(task));
+        }
+        cv_.notify_one();
+        return true;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- PoolFuture ----------------
+namespace detail {
+
+struct Unit {};
+
+template<class T>
+using Stored = std::conditional_t<std::is_void<T>::value, Unit, T>;
+
+template<class T>
+class State {
+public:
+    template<class... V>
+    void set_value(V&&... v) {
+        complete([&]{ value_.emplace(std::forward<V>(v)...); });
+    }
+    void set_exception(std::exception_ptr e) {
+        complete([&]{ error_ = std::move(e); });
+    }
+
+    // cb runs exactly once: now if already ready, else on the completing thread.
+    void on_ready(std::function<void()> cb) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (!ready_) { callbacks_.push_back(std::move(cb)); return; }
+        }
+        cb();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [this]{ return ready_; });
+    }
+    bool is_ready() {
+        std::lock_guard<std::mutex> lk(m_);
+        return ready_;
+    }
+
+    // Only valid once ready; the single consumer moves the value out.
+    bool failed() const { return error_ != nullptr; }
+    std::exception_ptr error() const { return error_; }
+    Stored<T> take() {
+        if (error_) std::rethrow_exception(error_);
+        return std::move(*value_);
+    }
+
+private:
+    template<class Store>
+    void complete(Store&& store) {
+        std::vector<std::function<void()>> cbs;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (ready_) throw std::logic_error("PoolFuture state already satisfied");
+            store();
+            ready_ = true;
+            cbs.swap(callbacks_);
+        }
+        cv_.notify_all();
+        for (auto& cb : cbs) cb();
+    }
+
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool ready_ = false;
+    std::optional<Stored<T>> value_;
+    std::exception_ptr error_;
+    std::vector<std::function<void()>> callbacks_;
+};
+
+// Runs on the pool; falls back to inline if the pool is gone or stopping.
+inline void schedule(ThreadPool* pool, std::function<void()> fn) {
+    if (pool && pool->post(fn)) return;
+    fn();
+}
+
+// Calls fn with the value of a ready state (or with nothing for void) and
+// stores the result, or the exception, in `out`.
+template<class T, class U, class Fn>
+void run_continuation(State<T>& in, State<U>& out, Fn& fn) {
+    if (in.failed()) { out.set_exception(in.error()); return; }
+    try {
+        if constexpr (std::is_void<T>::value) {
+            in.take();
+            if constexpr (std::is_void<U>::value) { fn(); out.set_value(); }
+            else                                  { out.set_value(fn()); }
+        } else {
+            if constexpr (std::is_void<U>::value) { fn(in.take()); out.set_value(); }
+            else                                  { out.set_value(fn(in.take())); }
+        }
+    } catch (...) {
+        out.set_exception(std::current_exception());
+    }
+}
+
+template<class T, class Fn>
+struct then_result { using type = std::invoke_result_t<Fn, T>; };
+template<class Fn>
+struct then_result<void, Fn> { using type = std::invoke_result_t<Fn>; };
+
+} // namespace detail
+
+template<class T>
+class PoolFuture {
+public:
+    PoolFuture() = default;
+    PoolFuture(std::shared_ptr<detail::State<T>> st, ThreadPool* pool)
+    : st_(std::move(st)), pool_(pool) {}
+
+    bool valid() const { return st_ != nullptr; }
+    bool is_ready() const { return st_ && st_->is_ready(); }
+    void wait() const { st_->wait(); }
+
+    // Blocks; for main() and tests. Inside the pool, prefer then().
+    T get() {
+        auto st = std::move(st_);
+        st->wait();
+        if constexpr (std::is_void<T>::value) st->take();
+        else                                  return st->take();
+    }
+
+    // Schedules fn(value) on the pool once this future is ready. If this
+    // future failed, fn is skipped and the exception passes through.
+    template<class Fn>
+    auto then(Fn fn) -> PoolFuture<typename detail::then_result<T, Fn>::type> {
+        using U = typename detail::then_result<T, Fn>::type;
+        auto next = std::make_shared<detail::State<U>>();
+        auto src = std::move(st_);
+        ThreadPool* pool = pool_;
+        src->on_ready([src, next, pool, fn = std::move(fn)]() mutable {
+            if (src->failed()) { next->set_exception(src->error()); return; }
+            detail::schedule(pool, [src, next, fn]() mutable {
+                detail::run_continuation(*src, *next, fn);
+            });
+        });
+        return PoolFuture<U>(std::move(next), pool);
+    }
+
+    ThreadPool* pool() const { return pool_; }
+
+private:
+    template<class> friend class PoolFuture;
+    template<class V> friend PoolFuture<std::vector<V>> when_all(std::vector<PoolFuture<V>>);
+    template<class V> friend PoolFuture<std::pair<std::size_t, V>> when_any(std::vector<PoolFuture<V>>);
+
+    std::shared_ptr<detail::State<T>> st_;
+    ThreadPool* pool_ = nullptr;
+};
+
+template<class F, class... A>
+auto ThreadPool::submit(F&& f, A&&... a) -> PoolFuture<std::invoke_result_t<F, A...>> {
+    using R = std::invoke_result_t<F, A...>;
+    auto st = std::make_shared<detail::State<R>>();
+    auto fn = std::bind(std::forward<F>(f), std::forward<A>(a)...);
+    bool ok = post([st, fn = std::move(fn)]() mutable {
+        try {
+            if constexpr (std::is_void<R>::value) { fn(); st->set_value(); }
+            else                                  { st->set_value(fn()); }
+        } catch (...) {
+            st->set_exception(std::current_exception());
+        }
+    });
+    if (!ok) throw std::runtime_error("submit on stopped pool");
+    return PoolFuture<R>(std::move(st), this);
+}
+
+// Ready when every input is ready; values keep input order. The first
+// exception (in completion order) fails the whole result.
+template<class T>
+PoolFuture<std::vector<T>> when_all(std::vector<PoolFuture<T>> futs) {
+    static_assert(!std::is_void<T>::value, "when_all needs value-returning futures");
+    struct Join {
+        explicit Join(std::size_t n) : slots(n), remaining(n) {}
+        std::vector<std::optional<T>> slots;
+        std::atomic<std::size_t> remaining;
+        std::atomic<bool> failed{false};
+        std::shared_ptr<detail::State<std::vector<T>>> out =
+            std::make_shared<detail::State<std::vector<T>>>();
+    };
+
+    ThreadPool* pool = futs.empty() ? nullptr : futs.front().pool_;
+    auto join = std::make_shared<Join>(futs.size());
+    PoolFuture<std::vector<T>> result(join->out, pool);
+    if (futs.empty()) { join->out->set_value(); return result; }
+
+    for (std::size_t i = 0; i < futs.size(); ++i) {
+        auto src = std::move(futs[i].st_);
+        src->on_ready([join, src, i] {
+            if (src->failed()) {
+                if (!join->failed.exchange(true)) join->out->set_exception(src->error());
+            } else {
+                join->slots[i].emplace(src->take());
+            }
+            if (join->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            if (join->failed.load()) return;
+            std::vector<T> values;
+            values.reserve(join->slots.size());
+            for (auto& s : join->slots) values.push_back(std::move(*s));
+            join->out->set_value(std::move(values));
+        });
+    }
+    return result;
+}
+
+// Ready when the first input is ready: its index and value (or exception).
+template<class T>
+PoolFuture<std::pair<std::size_t, T>> when_any(std::vector<PoolFuture<T>> futs) {
+    static_assert(!std::is_void<T>::value, "when_any needs value-returning futures");
+    if (futs.empty()) throw std::invalid_argument("when_any of no futures");
+    using Out = std::pair<std::size_t, T>;
+    auto out = std::make_shared<detail::State<Out>>();
+    auto won = std::make_shared<std::atomic<bool>>(false);
+    PoolFuture<Out> result(out, futs.front().pool_);
+
+    for (std::size_t i = 0; i < futs.size(); ++i) {
+        auto src = std::move(futs[i].st_);
+        src->on_ready([out, won, src, i] {
+            if (won->exchange(true)) return;                 // someone else finished first
+            if (src->failed()) out->set_exception(src->error());
+            else               out->set_value(i, src->take());
+        });
+    }
+    return result;
+}
+
+// ---------------- Demo ----------------
+int compute(int id) {
+    using namespace std::chrono_literals;
+    std::this_thread::sleep_for(50ms * (6 - id)); // different durations
+    return id * 10;
+}
+
+int main() {
+    using clock_type = std::chrono::steady_clock;
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    ThreadPool pool(10);                                     // both batches of five run at once
+
+    // Pipeline: compute -> scale -> format, each step scheduled on the pool.
+    auto text = pool.submit(compute, 3)
+                    .then([](int v) { return v * 2; })
+                    .then([](int v) { return "pipeline result " + std::to_string(v); });
+    std::cout << text.get() << "\n";                        // 60
+
+    // The homework, without polling: sum all five as soon as the last is ready.
+    auto t0 = clock_type::now();
+    std::vector<PoolFuture<int>> futs;
+    for (int i = 1; i <= 5; ++i) futs.push_back(pool.submit(compute, i));
+    auto first_done = clock_type::now();
+    std::vector<PoolFuture<int>> racers;
+    for (int i = 1; i <= 5; ++i) racers.push_back(pool.submit(compute, i));
+
+    auto sum = when_all(std::move(futs)).then([](std::vector<int> vs) {
+        int s = 0;
+        for (int v : vs) s += v;
+        return s;
+    });
+    auto first = when_any(std::move(racers)).then([&](std::pair<std::size_t, int> w) {
+        first_done = clock_type::now();
+        return w;
+    });
+
+    auto w = first.get();
+    std::cout << "first finished: index " << w.first << " value " << w.second
+              << " after " << duration_cast<milliseconds>(first_done - t0).count() << " ms\n";
+    std::cout << "Sum = " << sum.get() << " after "            // 150
+              << duration_cast<milliseconds>(clock_type::now() - t0).count() << " ms\n";
+
+    // Errors skip the remaining steps and surface at the end of the chain.
+    auto broken = pool.submit([]() -> int { throw std::runtime_error("stage 1 failed"); })
+                      .then([](int v) { std::cout << "never printed\n"; return v + 1; });
+    try {
+        broken.get();
+    } catch (const std::exception& e) {
+        std::cout << "chain error: " << e.what() << "\n";
+    }
+}
@@ -0,0 +1,453 @@
+// pool_coroutines.cpp
+// Build (needs C++20):
+//   g++ -std=c++20 -O2 -pthread code14-coroutines.cpp -o code14
+//
+// A job that calls future.get() inside a worker blocks that worker. With a
+// small pool and jobs that wait on sub-jobs, every worker ends up waiting on
+// work that is stuck in the queue behind them: pool starvation.
+//
+// pool_task<T> is a lazy coroutine. Inside it:
+//   co_await pool.schedule()         hop onto a pool worker
+//   co_await pool.submit(f, args...) suspend until the job is done; the worker
+//                                    is free to run other work meanwhile
+//   co_await other_task              run a nested pool_task
+// submit() keeps code1's template signature; its PoolFuture can still be
+// waited on with get(). sync_wait(task) and pool.spawn(task) connect
+// coroutines to ordinary blocking code such as main().
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template<class T> class PoolFuture;
+template<class T = void> class pool_task;
+
+// ---------------- ThreadPool ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Same signature as code1; the result is both blocking and awaitable.
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a) -> PoolFuture<std::invoke_result_t<F, A...>>;
+
+    void post(std::function<void()> task) {
+        if (!try_post(std::move(task))) throw std::runtime_error("submit on stopped pool");
+    }
+
+    // post() that reports a stopped pool instead of throwing.
+    bool try_post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) return false;
+            q_.push(std::move(task));
+        }
+        cv_.notify_one();
+        return true;
+    }
+
+    // co_await pool.schedule() resumes the coroutine on a worker.
+    auto schedule() {
+        struct Awaiter {
+            ThreadPool* pool;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h) { pool->post([h]{ h.resume(); }); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{this};
+    }
+
+    // Starts a pool_task on the pool; the result arrives through a PoolFuture.
+    template<class T>
+    PoolFuture<T> spawn(pool_task<T> task);
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- PoolFuture (blocking get + co_await) ----------------
+namespace detail {
+
+struct Unit {};
+template<class T>
+using Stored = std::conditional_t<std::is_void_v<T>, Unit, T>;
+
+template<class T>
+class State {
+public:
+    template<class... V>
+    void set_value(V&&... v) { complete([&]{ value_.emplace(std::forward<V>(v)...); }); }
+    void set_exception(std::exception_ptr e) { complete([&]{ error_ = std::move(e); }); }
+
+    // cb runs once: now if already ready, else on the completing thread.
+    void on_ready(std::function<void()> cb) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (!ready_) { callbacks_.push_back(std::move(cb)); return; }
+        }
+        cb();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [this]{ return ready_; });
+    }
+    bool is_ready() {
+        std::lock_guard<std::mutex> lk(m_);
+        return ready_;
+    }
+    Stored<T> take() {
+        if (error_) std::rethrow_exception(error_);
+        return std::move(*value_);
+    }
+
+private:
+    // The first completion wins; a second one is ignored.
+    template<class Store>
+    void complete(Store&& store) {
+        std::vector<std::function<void()>> cbs;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (ready_) return;
+            store();
+            ready_ = true;
+            cbs.swap(callbacks_);
+        }
+        cv_.notify_all();
+        for (auto& cb : cbs) cb();
+    }
+
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool ready_ = false;
+    std::optional<Stored<T>> value_;
+    std::exception_ptr error_;
+    std::vector<std::function<void()>> callbacks_;
+};
+
+} // namespace detail
+
+template<class T>
+class PoolFuture {
+public:
+    PoolFuture(std::shared_ptr<detail::State<T>> st, ThreadPool* pool)
+    : st_(std::move(st)), pool_(pool) {}
+
+    void wait() const { st_->wait(); }
+
+    // Blocking; fine in main(), starves the pool if called from a worker.
+    T get() {
+        st_->wait();
+        if constexpr (std::is_void_v<T>) st_->take();
+        else                             return st_->take();
+    }
+
+    // Suspends the coroutine; it is resumed on the pool once the value is set,
+    // or inline on the completing thread if the pool has stopped taking work.
+    auto operator co_await() {
+        struct Awaiter {
+            std::shared_ptr<detail::State<T>> st;
+            ThreadPool* pool;
+            bool await_ready() { return st->is_ready(); }
+            void await_suspend(std::coroutine_handle<> h) {
+                st->on_ready([pool = pool, h]{
+                    if (!pool->try_post([h]{ h.resume(); })) h.resume();
+                });
+            }
+            T await_resume() {
+                if constexpr (std::is_void_v<T>) st->take();
+                else                             return st->take();
+            }
+        };
+        return Awaiter{st_, pool_};
+    }
+
+private:
+    std::shared_ptr<detail::State<T>> st_;
+    ThreadPool* pool_;
+};
+
+template<class F, class... A>
+auto ThreadPool::submit(F&& f, A&&... a) -> PoolFuture<std::invoke_result_t<F, A...>> {
+    using R = std::invoke_result_t<F, A...>;
+    auto st = std::make_shared<detail::State<R>>();
+    post([st, fn = std::bind(std::forward<F>(f), std::forward<A>(a)...)]() mutable {
+        try {
+            if constexpr (std::is_void_v<R>) { fn(); st->set_value(); }
+            else                             { st->set_value(fn()); }
+        } catch (...) {
+            st->set_exception(std::current_exception());
+        }
+    });
+    return PoolFuture<R>(std::move(st), this);
+}
+
+// ---------------- pool_task<T> ----------------
+namespace detail {
+
+// Resumes whoever awaited the task (symmetric transfer, no stack growth).
+struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template<class P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+        if (auto c = h.promise().continuation) return c;
+        return std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }   // lazy
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+template<class T>
+struct TaskPromise : PromiseBase {
+    std::optional<T> value;
+    template<class V> void return_value(V&& v) { value.emplace(std::forward<V>(v)); }
+    T result() {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template<>
+struct TaskPromise<void> : PromiseBase {
+    void return_void() noexcept {}
+    void result() { if (error) std::rethrow_exception(error); }
+};
+
+// Fire-and-forget coroutine used by sync_wait/spawn: starts eagerly and
+// frees its own frame when it finishes.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+} // namespace detail
+
+template<class T>
+class pool_task {
+public:
+    struct promise_type : detail::TaskPromise<T> {
+        pool_task get_return_object() {
+            return pool_task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    pool_task(pool_task&& o) noexcept : h_(std::exchange(o.h_, {})) {}
+    pool_task& operator=(pool_task&& o) noexcept {
+        if (this != &o) { if (h_) h_.destroy(); h_ = std::exchange(o.h_, {}); }
+        return *this;
+    }
+    ~pool_task() { if (h_) h_.destroy(); }
+
+    // Awaiting starts the task and resumes the awaiter when it finishes.
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> h;
+            bool await_ready() const noexcept { return !h || h.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+                h.promise().continuation = caller;
+                return h;
+            }
+            T await_resume() { return h.promise().result(); }
+        };
+        return Awaiter{h_};
+    }
+
+private:
+    explicit pool_task(std::coroutine_handle<promise_type> h) : h_(h) {}
+    std::coroutine_handle<promise_type> h_;
+};
+
+namespace detail {
+
+template<class T>
+struct SyncWaitState {
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = false;
+    std::optional<Stored<T>> value;
+    std::exception_ptr error;
+};
+
+// A free function, not a lambda: a coroutine lambda's captures live in the
+// closure object, which is gone after the first suspension.
+template<class T>
+Detached sync_wait_body(pool_task<T> task, SyncWaitState<T>& st) {
+    {
+        pool_task<T> t = std::move(task);    // destroyed before the waiter is released
+        try {
+            if constexpr (std::is_void_v<T>) { co_await std::move(t); st.value.emplace(); }
+            else                             { st.value.emplace(co_await std::move(t)); }
+        } catch (...) {
+            st.error = std::current_exception();
+        }
+    }
+    std::lock_guard<std::mutex> lk(st.m);   // notify under the lock: the waiter
+    st.done = true;                          // may return and destroy st at once
+    st.cv.notify_one();
+}
+
+template<class T>
+Detached spawn_body(ThreadPool* pool, pool_task<T> task, std::shared_ptr<State<T>> st) {
+    co_await pool->schedule();
+    try {
+        if constexpr (std::is_void_v<T>) { co_await std::move(task); st->set_value(); }
+        else                             { st->set_value(co_await std::move(task)); }
+    } catch (...) {
+        st->set_exception(std::current_exception());
+    }
+}
+
+} // namespace detail
+
+// Runs a task to completion from ordinary code and blocks for its result.
+template<class T>
+T sync_wait(pool_task<T> task) {
+    detail::SyncWaitState<T> st;
+    detail::sync_wait_body(std::move(task), st);
+    std::unique_lock<std::mutex> lk(st.m);
+    st.cv.wait(lk, [&]{ return st.done; });
+    if (st.error) std::rethrow_exception(st.error);
+    if constexpr (!std::is_void_v<T>) return std::move(*st.value);
+}
+
+template<class T>
+PoolFuture<T> ThreadPool::spawn(pool_task<T> task) {
+    auto st = std::make_shared<detail::State<T>>();
+    detail::spawn_body(this, std::move(task), st);
+    return PoolFuture<T>(std::move(st), this);
+}
+
+// ---------------- Demo ----------------
+long long sum_range(long long l, long long r) {
+    long long s = 0;
+    for (long long i = l; i <= r; ++i) s += i;
+    return s;
+}
+
+// Coroutine style: the parent suspends and frees its worker.
+pool_task<long long> parent(ThreadPool& pool, int id) {
+    co_await pool.schedule();
+    long long a = co_await pool.submit(sum_range, 1, 1000 * id);
+    long long b = co_await pool.submit(sum_range, 1, 2000 * id);
+    co_return a + b;
+}
+
+pool_task<long long> all_parents(ThreadPool& pool, int n) {
+    std::vector<PoolFuture<long long>> futs;
+    for (int id = 1; id <= n; ++id) futs.push_back(pool.spawn(parent(pool, id)));
+    long long total = 0;
+    for (auto& f : futs) total += co_await f;
+    co_return total;
+}
+
+pool_task<> failing(ThreadPool& pool) {
+    co_await pool.schedule();
+    co_await pool.submit([]{ throw std::runtime_error("child job failed"); });
+}
+
+int main() {
+    using namespace std::chrono_literals;
+    const int PARENTS = 8;
+
+    // 1) Blocking parents on 2 workers: both workers end up waiting on
+    //    children that sit in the queue behind the other parents.
+    {
+        ThreadPool pool(2);
+        std::atomic<int> starved{0};
+        std::vector<PoolFuture<void>> parents;
+        for (int id = 1; id <= PARENTS; ++id)
+            parents.push_back(pool.submit([&pool, &starved, id]{
+                auto done = std::make_shared<std::promise<long long>>();
+                auto child = done->get_future();
+                pool.submit([done, id]{ done->set_value(sum_range(1, 1000 * id)); });
+                // A plain get() here would hang forever; a bounded wait shows it.
+                if (child.wait_for(100ms) == std::future_status::timeout) ++starved;
+            }));
+        for (auto& p : parents) p.get();
+        std::cout << "blocking get(): " << starved.load() << " of " << PARENTS
+                  << " parents timed out waiting on their own children\n";
+    }
+
+    // 2) Coroutine parents on the same 2 workers never block a worker.
+    {
+        ThreadPool pool(2);
+        auto t0 = std::chrono::steady_clock::now();
+        long long total = sync_wait(all_parents(pool, PARENTS));
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - t0).count();
+        long long expected = 0;
+        for (int id = 1; id <= PARENTS; ++id)
+            expected += sum_range(1, 1000 * id) + sum_range(1, 2000 * id);
+        std::cout << "co_await:       total " << total << " (expected " << expected
+                  << ") in " << ms << " ms\n";
+
+        try {
+            sync_wait(failing(pool));
+        } catch (const std::exception& e) {
+            std::cout << "co_await error: " << e.what() << "\n";
+        }
+    }
+}
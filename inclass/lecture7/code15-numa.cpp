@@ -0,0 +1,486 @@
+// numa_pool.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code15-numa.cpp -o code15
+//
+// code3's work-stealing pool, placed on the machine:
+//   - topology (online CPUs, core ids, NUMA nodes) is read from
+//     /sys/devices/system/cpu and filtered by the process affinity mask
+//   - PoolConfig{threads, pin}: with pin, worker i is bound to one CPU with
+//     pthread_setaffinity_np; workers are spread round-robin over nodes and
+//     fill distinct physical cores before SMT siblings
+//   - an idle worker steals from workers on its own node first and only then
+//     crosses nodes; external submits go to a worker on the caller's node
+// main() runs the same divide-and-conquer workload pinned and unpinned and
+// reports throughput plus perf_event_open counters (cache misses, CPU
+// migrations, context switches) when the kernel allows them.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// ---------------- Topology ----------------
+struct CpuInfo {
+    int cpu;
+    int node;       // NUMA node, 0 when the kernel exposes none
+    int package;    // socket
+    int core;       // core id within the package
+};
+
+class Topology {
+public:
+    // Online CPUs this process may run on, grouped by node.
+    static Topology detect() {
+        namespace fs = std::filesystem;
+        const fs::path root = "/sys/devices/system/cpu";
+        Topology t;
+
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+        for (int cpu : parse_cpu_list(read_line(root / "online"))) {
+            if (have_mask && !CPU_ISSET(cpu, &allowed)) continue;
+            const fs::path dir = root / ("cpu" + std::to_string(cpu));
+            CpuInfo info{cpu, 0, read_int(dir / "topology/physical_package_id", 0),
+                         read_int(dir / "topology/core_id", cpu)};
+            std::error_code ec;
+            for (const auto& e : fs::directory_iterator(dir, ec)) {   // cpuN/nodeK link
+                const std::string name = e.path().filename().string();
+                if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+                    std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+                    info.node = std::stoi(name.substr(4));
+                    break;
+                }
+            }
+            t.cpus_.push_back(info);
+        }
+
+        if (t.cpus_.empty()) {                                          // no sysfs: flat machine
+            unsigned n = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned i = 0; i < n; ++i) t.cpus_.push_back({static_cast<int>(i), 0, 0, static_cast<int>(i)});
+        }
+        std::sort(t.cpus_.begin(), t.cpus_.end(), [](const CpuInfo& a, const CpuInfo& b) {
+            return std::tie(a.node, a.cpu) < std::tie(b.node, b.cpu);
+        });
+        for (const auto& c : t.cpus_) t.nodes_ = std::max(t.nodes_, c.node + 1);
+        return t;
+    }
+
+    const std::vector<CpuInfo>& cpus() const { return cpus_; }
+    int nodes() const { return nodes_; }
+
+    // Node of a CPU id, or -1 if unknown.
+    int node_of(int cpu) const {
+        for (const auto& c : cpus_) if (c.cpu == cpu) return c.node;
+        return -1;
+    }
+
+    // CPUs for n workers: round-robin over nodes; within a node one CPU per
+    // physical core first, SMT siblings after. Wraps when n > CPUs.
+    std::vector<CpuInfo> placement(std::size_t n) const {
+        std::vector<std::vector<CpuInfo>> per_node(nodes_);
+        for (int node = 0; node < nodes_; ++node) {
+            std::vector<CpuInfo> firsts, siblings;
+            std::vector<std::pair<int, int>> seen;                      // (package, core)
+            for (const auto& c : cpus_) {
+                if (c.node != node) continue;
+                auto key = std::make_pair(c.package, c.core);
+                if (std::find(seen.begin(), seen.end(), key) == seen.end()) {
+                    seen.push_back(key);
+                    firsts.push_back(c);
+                } else {
+                    siblings.push_back(c);
+                }
+            }
+            per_node[node] = firsts;
+            per_node[node].insert(per_node[node].end(), siblings.begin(), siblings.end());
+        }
+
+        std::vector<CpuInfo> order;
+        for (std::size_t k = 0; order.size() < cpus_.size(); ++k)
+            for (int node = 0; node < nodes_; ++node)
+                if (k < per_node[node].size()) order.push_back(per_node[node][k]);
+
+        std::vector<CpuInfo> out;
+        for (std::size_t i = 0; i < n; ++i) out.push_back(order[i % order.size()]);
+        return out;
+    }
+
+private:
+    static std::string read_line(const std::filesystem::path& p) {
+        std::ifstream in(p);
+        std::string s;
+        std::getline(in, s);
+        return s;
+    }
+
+    static int read_int(const std::filesystem::path& p, int fallback) {
+        std::string s = read_line(p);
+        try { return s.empty() ? fallback : std::stoi(s); } catch (...) { return fallback; }
+    }
+
+    // "0-3,8,10-11" -> {0,1,2,3,8,10,11}
+    static std::vector<int> parse_cpu_list(const std::string& s) {
+        std::vector<int> out;
+        std::stringstream ss(s);
+        std::string part;
+        while (std::getline(ss, part, ',')) {
+            if (part.empty()) continue;
+            auto dash = part.find('-');
+            int lo = std::stoi(part.substr(0, dash));
+            int hi = dash == std::string::npos ? lo : std::stoi(part.substr(dash + 1));
+            for (int c = lo; c <= hi; ++c) out.push_back(c);
+        }
+        return out;
+    }
+
+    std::vector<CpuInfo> cpus_;
+    int nodes_ = 1;
+};
+
+// ---------------- NumaPool ----------------
+struct PoolConfig {
+    std::size_t threads = 0;    // 0: one per usable CPU
+    bool pin = true;            // bind each worker to its CPU
+};
+
+class NumaPool {
+public:
+    explicit NumaPool(PoolConfig cfg = {}, const Topology& topo = Topology::detect())
+    : topo_(topo), pin_(cfg.pin) {
+        std::size_t n = cfg.threads ? cfg.threads : topo_.cpus().size();
+        placement_ = topo_.placement(n);
+
+        queues_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            queues_.push_back(std::make_unique<WorkQueue>());
+
+        // Victim order per worker: same node first (starting after itself so
+        // thieves do not all hit the same queue), then the other nodes.
+        node_workers_.resize(topo_.nodes());
+        for (std::size_t i = 0; i < n; ++i) node_workers_[placement_[i].node].push_back(i);
+        victims_.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            for (std::size_t k = 1; k < n; ++k) {
+                std::size_t v = (i + k) % n;
+                if (placement_[v].node == placement_[i].node) victims_[i].push_back(v);
+            }
+            for (std::size_t k = 1; k < n; ++k) {
+                std::size_t v = (i + k) % n;
+                if (placement_[v].node != placement_[i].node) victims_[i].push_back(v);
+            }
+        }
+
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            workers_.emplace_back([this, i]{ worker_loop(i); });
+    }
+
+    NumaPool(const NumaPool&) = delete;
+    NumaPool& operator=(const NumaPool&) = delete;
+
+    // Fire-and-forget
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit and get future
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        if (stop_.load(std::memory_order_acquire))
+            throw std::runtime_error("submit on stopped pool");
+        push([pkg]{ (*pkg)(); });
+        return fut;
+    }
+
+    std::size_t size() const { return workers_.size(); }
+    const std::vector<CpuInfo>& placement() const { return placement_; }
+    std::size_t pinned_count() const { return pinned_.load(std::memory_order_relaxed); }
+    std::size_t local_steals() const { return local_steals_.load(std::memory_order_relaxed); }
+    std::size_t remote_steals() const { return remote_steals_.load(std::memory_order_relaxed); }
+
+    ~NumaPool() {
+        {
+            std::lock_guard<std::mutex> lk(idle_m_);
+            stop_.store(true, std::memory_order_release);
+        }
+        idle_cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex m;
+        std::deque<std::function<void()>> dq;
+    };
+
+    // Worker on the caller's node, round-robin; any worker if the node has none.
+    std::size_t pick_external() {
+        std::size_t rr = next_.fetch_add(1, std::memory_order_relaxed);
+        int node = topo_.node_of(sched_getcpu());
+        if (node >= 0 && node < static_cast<int>(node_workers_.size()) && !node_workers_[node].empty())
+            return node_workers_[node][rr % node_workers_[node].size()];
+        return rr % queues_.size();
+    }
+
+    void push(std::function<void()> task) {
+        std::size_t idx = tls_pool_ == this ? tls_index_ : pick_external();
+        {
+            std::lock_guard<std::mutex> lk(queues_[idx]->m);
+            queues_[idx]->dq.push_back(std::move(task));
+        }
+        pending_.fetch_add(1);
+        if (sleepers_.load() == 0) return;              // see worker_loop
+        { std::lock_guard<std::mutex> lk(idle_m_); }
+        idle_cv_.notify_one();
+    }
+
+    bool pop_local(std::size_t i, std::function<void()>& out) {
+        WorkQueue& wq = *queues_[i];
+        std::lock_guard<std::mutex> lk(wq.m);
+        if (wq.dq.empty()) return false;
+        out = std::move(wq.dq.back());
+        wq.dq.pop_back();
+        return true;
+    }
+
+    bool steal(std::size_t thief, std::function<void()>& out) {
+        for (std::size_t v : victims_[thief]) {
+            WorkQueue& wq = *queues_[v];
+            std::unique_lock<std::mutex> lk(wq.m, std::try_to_lock);
+            if (!lk.owns_lock() || wq.dq.empty()) continue;
+            out = std::move(wq.dq.front());
+            wq.dq.pop_front();
+            (placement_[v].node == placement_[thief].node ? local_steals_ : remote_steals_)
+                .fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void pin_self(std::size_t i) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(placement_[i].cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+            pinned_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void worker_loop(std::size_t i) {
+        // Pin before touching anything, so the worker's own allocations are
+        // first-touched on its node.
+        if (pin_) pin_self(i);
+        tls_pool_ = this;
+        tls_index_ = i;
+        std::function<void()> task;
+        for (;;) {
+            if (pop_local(i, task) || steal(i, task)) {
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                try { task(); } catch (...) { /* swallow/log */ }
+                task = nullptr;
+                continue;
+            }
+            // Registered as a sleeper before re-checking pending_: a push
+            // either sees us and notifies, or we see its task.
+            std::unique_lock<std::mutex> lk(idle_m_);
+            sleepers_.fetch_add(1);
+            idle_cv_.wait(lk, [this]{
+                return stop_.load(std::memory_order_relaxed) || pending_.load() > 0;
+            });
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+            if (stop_.load(std::memory_order_relaxed) &&
+                pending_.load(std::memory_order_acquire) == 0) return;
+        }
+    }
+
+    Topology topo_;
+    bool pin_;
+    std::vector<CpuInfo> placement_;                    // placement_[i]: CPU of worker i
+    std::vector<std::vector<std::size_t>> node_workers_;
+    std::vector<std::vector<std::size_t>> victims_;
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> next_{0};
+    std::atomic<std::size_t> pending_{0};
+    std::atomic<std::size_t> sleepers_{0};             // workers in (or entering) idle_cv_.wait
+    std::atomic<std::size_t> pinned_{0};
+    std::atomic<std::size_t> local_steals_{0};
+    std::atomic<std::size_t> remote_steals_{0};
+    std::atomic<bool> stop_{false};
+    std::mutex idle_m_;
+    std::condition_variable idle_cv_;
+
+    inline static thread_local NumaPool* tls_pool_ = nullptr;
+    inline static thread_local std::size_t tls_index_ = 0;
+};
+
+// ---------------- perf_event_open counters ----------------
+// Counts for this process, including threads created after start(). With
+// inherit, a thread's counts reach the parent's fd when it exits, so read
+// after the pool is destroyed.
+class PerfCounters {
+public:
+    struct Counter {
+        const char* name;
+        std::uint32_t type;
+        std::uint64_t config;
+        int fd = -1;
+    };
+
+    PerfCounters() {
+        counters_ = {{"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                     {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+                     {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}};
+    }
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    ~PerfCounters() { for (auto& c : counters_) if (c.fd >= 0) close(c.fd); }
+
+    void start() {
+        for (auto& c : counters_) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = c.type;
+            attr.config = c.config;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = c.type == PERF_TYPE_HARDWARE;    // sw events are kernel-side
+            attr.exclude_hv = 1;
+            c.fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (c.fd >= 0) {
+                ioctl(c.fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(c.fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    // -1 when the counter could not be opened (no PMU, perf_event_paranoid, ...).
+    std::vector<std::pair<const char*, long long>> stop() {
+        std::vector<std::pair<const char*, long long>> out;
+        for (auto& c : counters_) {
+            long long v = -1;
+            if (c.fd >= 0) {
+                ioctl(c.fd, PERF_EVENT_IOC_DISABLE, 0);
+                std::uint64_t raw = 0;
+                if (read(c.fd, &raw, sizeof(raw)) == sizeof(raw)) v = static_cast<long long>(raw);
+                close(c.fd);
+                c.fd = -1;
+            }
+            out.emplace_back(c.name, v);
+        }
+        return out;
+    }
+
+private:
+    std::vector<Counter> counters_;
+};
+
+// ---------------- Demo / benchmark ----------------
+// Divide and conquer over one array: split until a 64 KB leaf, then make a
+// few passes over it. Children stay on the splitting worker's deque, so the
+// data a worker touches is usually still in its caches, unless the OS moved it.
+void process(NumaPool& pool, std::uint32_t* data, std::size_t n,
+             std::atomic<long>& outstanding, std::promise<void>& done) {
+    constexpr std::size_t kLeaf = 16 * 1024;                 // uint32s = 64 KB
+    while (n > kLeaf) {
+        std::size_t half = n / 2;
+        outstanding.fetch_add(1, std::memory_order_relaxed);
+        pool.enqueue([&pool, d = data + half, m = n - half, &outstanding, &done]{
+            process(pool, d, m, outstanding, done);
+        });
+        n = half;
+    }
+    for (int pass = 0; pass < 8; ++pass)
+        for (std::size_t i = 0; i < n; ++i) data[i] = data[i] * 2654435761u + pass;
+    if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) done.set_value();
+}
+
+void run(const char* name, const Topology& topo, PoolConfig cfg, std::vector<std::uint32_t>& data, int rounds) {
+    PerfCounters perf;
+    perf.start();
+    auto s = std::chrono::steady_clock::now();
+    std::size_t pinned = 0, local = 0, remote = 0;
+    {
+        NumaPool pool(cfg, topo);
+        for (int r = 0; r < rounds; ++r) {
+            std::atomic<long> outstanding{1};
+            std::promise<void> done;
+            pool.enqueue([&]{ process(pool, data.data(), data.size(), outstanding, done); });
+            done.get_future().wait();
+        }
+        pinned = pool.pinned_count();
+        local = pool.local_steals();
+        remote = pool.remote_steals();
+    }
+    auto e = std::chrono::steady_clock::now();
+    auto counts = perf.stop();
+
+    double sec = std::chrono::duration<double>(e - s).count();
+    double mb = static_cast<double>(data.size()) * sizeof(std::uint32_t) * rounds / 1e6;
+    std::cout << std::left << std::setw(9) << name << std::right
+              << std::fixed << std::setprecision(1) << std::setw(8) << mb / sec << " MB/s"
+              << "  pinned " << pinned
+              << "  steals local/remote " << local << "/" << remote;
+    for (const auto& [cname, v] : counts) {
+        std::cout << "  " << cname << " ";
+        if (v < 0) std::cout << "n/a";
+        else       std::cout << v;
+    }
+    std::cout << "\n";
+}
+
+int main() {
+    Topology topo = Topology::detect();
+    std::cout << "usable CPUs: " << topo.cpus().size() << ", NUMA nodes: " << topo.nodes() << "\n";
+    {
+        NumaPool pool(PoolConfig{0, true}, topo);
+        std::cout << "placement:";
+        for (std::size_t i = 0; i < pool.size(); ++i)
+            std::cout << " w" << i << "->cpu" << pool.placement()[i].cpu
+                      << "/n" << pool.placement()[i].node;
+        std::cout << "\n";
+        std::cout << "submit check: " << pool.submit([](int a, int b){ return a + b; }, 21, 21).get() << "\n";
+    }
+
+    std::vector<std::uint32_t> data(32u << 20 >> 2, 1);       // 32 MB
+    const int rounds = 10;
+    for (int rep = 0; rep < 2; ++rep) {
+        run("unpinned", topo, PoolConfig{0, false}, data, rounds);
+        run("pinned",   topo, PoolConfig{0, true},  data, rounds);
+        run("4 pinned", topo, PoolConfig{4, true},  data, rounds);
+    }
+}
@@ -0,0 +1,349 @@
+// spin_then_park.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code16-spinwait.cpp -o code16
+//
+// code2's TSQueue pool with a configurable wait policy for wait_pop (and so
+// for the worker loop, which is just a wait_pop loop):
+//   WaitPolicy::blocking()          straight to cv_.wait, as before (default)
+//   WaitPolicy::adaptive_spin(s, y) s try_pops with `pause` between, then y
+//                                   with yield, then park on a futex
+// A handoff to a parked worker costs a futex wake plus a scheduler round
+// trip, several microseconds. A worker still spinning picks the job up in
+// well under one. wait_stats() counts which phase served each pop, so the
+// spin/yield budgets can be tuned against real traffic.
+// Spin and yield phases are switched off on single-CPU machines, where they
+// only delay the producer the waiter is waiting for.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// ---------------- futex ----------------
+namespace futex {
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) &&
+              std::atomic<std::uint32_t>::is_always_lock_free,
+              "futex word must be a plain 32-bit integer");
+
+// Sleeps while word == expected (returns at once if it already changed).
+inline void wait(std::atomic<std::uint32_t>& word, std::uint32_t expected) {
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE,
+            expected, nullptr, nullptr, 0);
+}
+
+inline void wake(std::atomic<std::uint32_t>& word, int n) {
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE_PRIVATE,
+            n, nullptr, nullptr, 0);
+}
+
+} // namespace futex
+
+// ---------------- Wait policy ----------------
+struct WaitPolicy {
+    unsigned spins = 0;     // try_pop attempts with cpu_relax() between
+    unsigned yields = 0;    // then attempts with std::this_thread::yield() between
+    bool adaptive = false;  // false: park on the condition variable right away
+
+    static WaitPolicy blocking() { return {}; }
+    static WaitPolicy adaptive_spin(unsigned spins = 2000, unsigned yields = 32) {
+        return {spins, yields, true};
+    }
+};
+
+struct WaitStats {
+    std::uint64_t ready = 0;        // item was already there
+    std::uint64_t spin = 0;         // served while spinning
+    std::uint64_t yield = 0;        // served while yielding
+    std::uint64_t park = 0;         // served after sleeping
+    std::uint64_t wakes = 0;        // futex wakes issued by producers
+};
+
+// ---------------- TSQueue (thread-safe, closeable; as in code2) ----------------
+template <class T>
+class TSQueue {
+public:
+    explicit TSQueue(WaitPolicy policy = WaitPolicy::blocking()) : policy_(policy) {
+        // With one CPU the thread we wait for cannot run while we spin, and a
+        // yield hands it a whole timeslice before we look again: park at once.
+        if (std::thread::hardware_concurrency() <= 1) policy_.spins = policy_.yields = 0;
+    }
+
+    TSQueue(const TSQueue&) = delete;
+    TSQueue& operator=(const TSQueue&) = delete;
+
+    template<class... Args>
+    bool emplace(Args&&... args) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (closed_.load(std::memory_order_relaxed)) return false;
+            q_.emplace(std::forward<Args>(args)...);
+            size_.store(q_.size(), std::memory_order_release);
+        }
+        wake_one();
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (q_.empty()) return false;
+        out = std::move(q_.front());
+        q_.pop();
+        size_.store(q_.size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    // Blocks until item available OR queue is closed & drained.
+    bool wait_pop(T& out) {
+        if (!policy_.adaptive) return blocking_pop(out);
+
+        if (try_pop(out)) { count(ready_); return true; }
+        for (unsigned i = 0; i < policy_.spins; ++i) {
+            cpu_relax();
+            // Peek without the lock so spinners do not hammer m_.
+            if (size_.load(std::memory_order_acquire) != 0 && try_pop(out)) { count(spin_); return true; }
+            if (closed_.load(std::memory_order_acquire)) break;
+        }
+        for (unsigned i = 0; i < policy_.yields; ++i) {
+            std::this_thread::yield();
+            if (size_.load(std::memory_order_acquire) != 0 && try_pop(out)) { count(yield_); return true; }
+            if (closed_.load(std::memory_order_acquire)) break;
+        }
+        // A pop that wins before the first futex::wait never slept: it is
+        // credited to the last phase we went through, not to park.
+        bool slept = false;
+        for (;;) {
+            // Read seq_ before announcing ourselves: a push after this point
+            // bumps it, and futex::wait then returns immediately.
+            std::uint32_t seq = seq_.load(std::memory_order_acquire);
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (try_pop(out)) {
+                sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                count(slept ? park_ : policy_.yields ? yield_ : policy_.spins ? spin_ : ready_);
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                return false;                                  // closed and drained
+            }
+            futex::wait(seq_, seq);
+            slept = true;
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            closed_.store(true, std::memory_order_release);
+        }
+        cv_.notify_all();
+        seq_.fetch_add(1, std::memory_order_release);
+        futex::wake(seq_, INT_MAX);
+    }
+
+    WaitStats stats() const {
+        WaitStats s;
+        s.ready = ready_.load(std::memory_order_relaxed);
+        s.spin = spin_.load(std::memory_order_relaxed);
+        s.yield = yield_.load(std::memory_order_relaxed);
+        s.park = park_.load(std::memory_order_relaxed);
+        s.wakes = wakes_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    bool blocking_pop(T& out) {
+        std::unique_lock<std::mutex> lk(m_);
+        bool waited = false;
+        cv_.wait(lk, [&]{
+            bool go = closed_.load(std::memory_order_relaxed) || !q_.empty();
+            waited |= !go;
+            return go;
+        });
+        if (q_.empty()) return false; // closed and drained
+        out = std::move(q_.front());
+        q_.pop();
+        size_.store(q_.size(), std::memory_order_relaxed);
+        count(waited ? park_ : ready_);
+        return true;
+    }
+
+    void wake_one() {
+        if (!policy_.adaptive) { cv_.notify_one(); return; }
+        // Pairs with the fence in wait_pop: either the sleeper's try_pop sees
+        // the item, or we see the sleeper. Nobody asleep, no syscall.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) == 0) return;
+        seq_.fetch_add(1, std::memory_order_release);
+        futex::wake(seq_, 1);
+        count(wakes_);
+    }
+
+    static void count(std::atomic<std::uint64_t>& c) { c.fetch_add(1, std::memory_order_relaxed); }
+
+    WaitPolicy policy_;
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    std::queue<T> q_;
+    std::atomic<bool> closed_{false};
+    std::atomic<std::size_t> size_{0};           // q_.size(), readable without m_
+    std::atomic<std::uint32_t> seq_{0};          // futex word
+    std::atomic<std::uint32_t> sleepers_{0};
+    std::atomic<std::uint64_t> ready_{0}, spin_{0}, yield_{0}, park_{0}, wakes_{0};
+};
+
+// ---------------- ThreadPool using TSQueue ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency(),
+                        WaitPolicy policy = WaitPolicy::blocking())
+    : tasks_(policy) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this]{
+                std::function<void()> task;
+                while (tasks_.wait_pop(task)) {
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    // Fire-and-forget
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit and get future
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        if (!tasks_.emplace([pkg]{ (*pkg)(); })) {
+            throw std::runtime_error("submit on stopped pool");
+        }
+        return fut;
+    }
+
+    WaitStats wait_stats() const { return tasks_.stats(); }
+
+    void shutdown() {
+        tasks_.close();
+    }
+
+    ~ThreadPool() {
+        tasks_.close(); // signal shutdown
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    TSQueue<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+};
+
+// ---------------- Demo / benchmark ----------------
+using clock_type = std::chrono::steady_clock;
+
+void spin_for(std::chrono::nanoseconds d) {
+    auto end = clock_type::now() + d;
+    while (clock_type::now() < end) {}
+}
+
+double percentile(std::vector<double> v, double p) {
+    std::sort(v.begin(), v.end());
+    return v[static_cast<std::size_t>(p * (v.size() - 1))];
+}
+
+void print_stats(const WaitStats& s) {
+    std::cout << "    pops served: ready " << s.ready << ", spin " << s.spin
+              << ", yield " << s.yield << ", park " << s.park
+              << "; futex wakes " << s.wakes << "\n";
+}
+
+// Sub-10us jobs arriving with short idle gaps: submit-to-start latency.
+void latency(const char* name, WaitPolicy policy) {
+    using namespace std::chrono_literals;
+    const int N = 20000;
+    std::vector<double> lat_us(N);
+    ThreadPool pool(2, policy);
+    std::vector<std::future<void>> futs;
+    futs.reserve(N);
+    for (int i = 0; i < N; ++i) {
+        auto t0 = clock_type::now();
+        futs.push_back(pool.submit([t0, i, &lat_us]{
+            lat_us[i] = std::chrono::duration<double, std::micro>(clock_type::now() - t0).count();
+            spin_for(2us);
+        }));
+        spin_for(20us);                                      // gap: workers go idle
+    }
+    for (auto& f : futs) f.get();
+    std::cout << "  " << std::left << std::setw(9) << name << std::right << std::fixed
+              << std::setprecision(2) << "latency p50 " << std::setw(7) << percentile(lat_us, 0.50)
+              << " us, p99 " << std::setw(7) << percentile(lat_us, 0.99) << " us\n";
+    print_stats(pool.wait_stats());
+}
+
+// Many tiny jobs back to back: throughput.
+void throughput(const char* name, WaitPolicy policy) {
+    const int N = 200000;
+    std::atomic<int> done{0};
+    std::promise<void> all;
+    auto s = clock_type::now();
+    {
+        ThreadPool pool(4, policy);
+        for (int i = 0; i < N; ++i)
+            pool.enqueue([&]{ if (done.fetch_add(1, std::memory_order_relaxed) + 1 == N) all.set_value(); });
+        all.get_future().wait();
+        auto e = clock_type::now();
+        std::cout << "  " << std::left << std::setw(9) << name << std::right << std::fixed
+                  << std::setprecision(2) << "throughput "
+                  << N / std::chrono::duration<double>(e - s).count() / 1e6 << " M jobs/s\n";
+        print_stats(pool.wait_stats());
+    }
+}
+
+int main() {
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency()
+              << (std::thread::hardware_concurrency() <= 1 ? " (spin/yield phases disabled)" : "") << "\n";
+    {
+        ThreadPool pool(4);
+        std::cout << "default (blocking) add: " << pool.submit([](int a, int b){ return a + b; }, 21, 21).get() << "\n";
+    }
+    latency("blocking", WaitPolicy::blocking());
+    latency("adaptive", WaitPolicy::adaptive_spin());
+    throughput("blocking", WaitPolicy::blocking());
+    throughput("adaptive", WaitPolicy::adaptive_spin());
+}
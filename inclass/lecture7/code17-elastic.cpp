@@ -0,0 +1,348 @@
+// elastic_pool.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code17-elastic.cpp -o code17
+//
+// code1's shared-queue pool, but the worker count moves between bounds:
+//   - ElasticConfig{min_workers, max_workers, grow_after, keep_alive, max_spare}
+//   - grow: when the oldest queued job has waited longer than grow_after and
+//     no worker is idle, one worker is added (checked on submit and by a
+//     small supervisor thread, so a stalled pool still grows)
+//   - shrink: a worker idle for keep_alive exits, down to min_workers
+//   - compensate: a job about to block (sleep, I/O, future::get) opens an
+//     ElasticPool::BlockingScope; blocked workers do not count against
+//     max_workers, so up to max_spare extra workers can keep the queue moving
+// metrics() and recent_events() expose every resize decision and why.
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct ElasticConfig {
+    std::size_t min_workers = 1;
+    std::size_t max_workers = std::max(1u, std::thread::hardware_concurrency());
+    std::chrono::microseconds grow_after{1000};     // queue wait that triggers growth
+    std::chrono::milliseconds keep_alive{250};      // idle time before a worker retires
+    std::size_t max_spare = 8;                      // extra workers for blocked ones
+};
+
+struct ResizeMetrics {
+    std::size_t live = 0;               // workers running right now
+    std::size_t idle = 0;
+    std::size_t blocked = 0;            // inside a BlockingScope
+    std::size_t queued = 0;
+    std::size_t peak = 0;
+    std::size_t grown_for_wait = 0;
+    std::size_t grown_for_blocking = 0;
+    std::size_t retired = 0;
+};
+
+struct ResizeEvent {
+    enum class Kind { GrowWait, GrowBlocking, Retire };
+    Kind kind;
+    std::chrono::steady_clock::time_point when;
+    std::size_t live_after;
+    std::chrono::microseconds queue_wait;       // oldest job's wait (growth only)
+};
+
+class ElasticPool {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    explicit ElasticPool(ElasticConfig cfg = {}) : cfg_(cfg) {
+        if (cfg_.min_workers == 0) cfg_.min_workers = 1;
+        cfg_.max_workers = std::max(cfg_.max_workers, cfg_.min_workers);
+        std::lock_guard<std::mutex> lk(m_);
+        for (std::size_t i = 0; i < cfg_.min_workers; ++i) spawn_locked();
+        supervisor_ = std::thread([this]{ supervise(); });
+    }
+
+    ElasticPool(const ElasticPool&) = delete;
+    ElasticPool& operator=(const ElasticPool&) = delete;
+
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        std::vector<std::thread> reaped;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.push_back({[pkg]{ (*pkg)(); }, clock_type::now()});
+            maybe_grow_locked();
+            reaped = reap_locked();
+        }
+        cv_.notify_one();
+        sup_cv_.notify_one();
+        for (auto& t : reaped) t.join();
+        return fut;
+    }
+
+    // Marks the calling job as blocked for its lifetime. Outside a pool
+    // worker it does nothing, so library code can use it unconditionally.
+    class BlockingScope {
+    public:
+        BlockingScope() : pool_(tls_pool_) { if (pool_) pool_->enter_blocking(); }
+        ~BlockingScope() { if (pool_) pool_->leave_blocking(); }
+        BlockingScope(const BlockingScope&) = delete;
+        BlockingScope& operator=(const BlockingScope&) = delete;
+    private:
+        ElasticPool* pool_;
+    };
+
+    ResizeMetrics metrics() const {
+        std::lock_guard<std::mutex> lk(m_);
+        ResizeMetrics r = counters_;
+        r.live = live_;
+        r.idle = idle_;
+        r.blocked = blocked_;
+        r.queued = q_.size();
+        return r;
+    }
+
+    std::vector<ResizeEvent> recent_events() const {
+        std::lock_guard<std::mutex> lk(m_);
+        return {events_.begin(), events_.end()};
+    }
+
+    ~ElasticPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        sup_cv_.notify_all();
+        supervisor_.join();
+        std::vector<std::thread> all;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            for (auto& kv : threads_) all.push_back(std::move(kv.second));
+            threads_.clear();
+        }
+        for (auto& t : all) t.join();
+    }
+
+private:
+    struct Item {
+        std::function<void()> fn;
+        clock_type::time_point enqueued;
+    };
+
+    static constexpr std::size_t kMaxEvents = 64;
+
+    void spawn_locked() {
+        std::thread t([this]{ worker_loop(); });
+        threads_.emplace(t.get_id(), std::move(t));
+        ++live_;
+        counters_.peak = std::max(counters_.peak, live_);
+    }
+
+    void record_locked(ResizeEvent::Kind kind, std::chrono::microseconds waited) {
+        if (events_.size() == kMaxEvents) events_.pop_front();
+        events_.push_back({kind, clock_type::now(), live_, waited});
+    }
+
+    // Room for one more worker? Blocked workers do not count against
+    // max_workers, only against the hard cap of max_workers + max_spare.
+    bool can_grow_locked() const {
+        return live_ - blocked_ < cfg_.max_workers && live_ < cfg_.max_workers + cfg_.max_spare;
+    }
+
+    void maybe_grow_locked() {
+        if (stop_ || q_.empty() || idle_ > 0 || !can_grow_locked()) return;
+        auto waited = std::chrono::duration_cast<std::chrono::microseconds>(
+            clock_type::now() - q_.front().enqueued);
+        if (waited < cfg_.grow_after) return;
+        spawn_locked();
+        ++counters_.grown_for_wait;
+        record_locked(ResizeEvent::Kind::GrowWait, waited);
+    }
+
+    // Threads of retired workers; joined by the caller after unlocking.
+    std::vector<std::thread> reap_locked() {
+        std::vector<std::thread> out;
+        for (auto id : retired_) {
+            auto it = threads_.find(id);
+            out.push_back(std::move(it->second));
+            threads_.erase(it);
+        }
+        retired_.clear();
+        return out;
+    }
+
+    void enter_blocking() {
+        std::lock_guard<std::mutex> lk(m_);
+        ++blocked_;
+        // Replace the blocked worker only if someone is waiting for one.
+        if (stop_ || q_.empty() || idle_ > 0 || !can_grow_locked()) return;
+        spawn_locked();
+        ++counters_.grown_for_blocking;
+        record_locked(ResizeEvent::Kind::GrowBlocking, std::chrono::microseconds(0));
+    }
+
+    void leave_blocking() {
+        std::lock_guard<std::mutex> lk(m_);
+        --blocked_;             // extra workers drain away through keep_alive
+    }
+
+    void worker_loop() {
+        tls_pool_ = this;
+        std::unique_lock<std::mutex> lk(m_);
+        for (;;) {
+            ++idle_;
+            bool ready = cv_.wait_for(lk, cfg_.keep_alive, [this]{ return stop_ || !q_.empty(); });
+            --idle_;
+            if (!ready) {
+                if (live_ > cfg_.min_workers) {
+                    --live_;
+                    ++counters_.retired;
+                    retired_.push_back(std::this_thread::get_id());
+                    record_locked(ResizeEvent::Kind::Retire, std::chrono::microseconds(0));
+                    sup_cv_.notify_one();                   // supervisor joins us
+                    return;
+                }
+                continue;
+            }
+            if (q_.empty()) { --live_; return; }       // stopping and drained
+            Item item = std::move(q_.front());
+            q_.pop_front();
+            lk.unlock();
+            try { item.fn(); } catch (...) { /* swallow/log */ }
+            lk.lock();
+        }
+    }
+
+    // Grows a pool whose workers are all stuck, even if nobody submits.
+    void supervise() {
+        std::vector<std::thread> reaped;
+        std::unique_lock<std::mutex> lk(m_);
+        while (!stop_) {
+            if (q_.empty()) sup_cv_.wait(lk, [this]{ return stop_ || !q_.empty() || !retired_.empty(); });
+            else            sup_cv_.wait_for(lk, cfg_.grow_after / 2);
+            maybe_grow_locked();
+            reaped = reap_locked();
+            if (!reaped.empty()) {
+                lk.unlock();
+                for (auto& t : reaped) t.join();
+                lk.lock();
+            }
+        }
+    }
+
+    ElasticConfig cfg_;
+    mutable std::mutex m_;
+    std::condition_variable cv_;            // workers
+    std::condition_variable sup_cv_;        // supervisor
+    std::deque<Item> q_;
+    std::unordered_map<std::thread::id, std::thread> threads_;
+    std::vector<std::thread::id> retired_;  // exited, not yet joined
+    std::thread supervisor_;
+    std::size_t live_ = 0;
+    std::size_t idle_ = 0;
+    std::size_t blocked_ = 0;
+    ResizeMetrics counters_;
+    std::deque<ResizeEvent> events_;
+    bool stop_ = false;
+
+    inline static thread_local ElasticPool* tls_pool_ = nullptr;
+};
+
+// ---------------- Demo ----------------
+using namespace std::chrono_literals;
+
+void print_metrics(const char* when, const ResizeMetrics& m) {
+    std::cout << "  " << std::left << std::setw(22) << when << std::right
+              << "live " << m.live << " (idle " << m.idle << ", blocked " << m.blocked
+              << "), queued " << m.queued << ", peak " << m.peak
+              << ", grown wait/blocking " << m.grown_for_wait << "/" << m.grown_for_blocking
+              << ", retired " << m.retired << "\n";
+}
+
+const char* kind_name(ResizeEvent::Kind k) {
+    switch (k) {
+        case ResizeEvent::Kind::GrowWait:     return "grow (queue wait)";
+        case ResizeEvent::Kind::GrowBlocking: return "grow (blocked job)";
+        case ResizeEvent::Kind::Retire:       return "retire (idle)";
+    }
+    return "?";
+}
+
+int main() {
+    auto t0 = ElasticPool::clock_type::now();
+    auto ms_since = [&](ElasticPool::clock_type::time_point t) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(t - t0).count();
+    };
+
+    ElasticConfig cfg;
+    cfg.min_workers = 1;
+    cfg.max_workers = 8;
+    cfg.grow_after = 2ms;
+    cfg.keep_alive = 100ms;
+    cfg.max_spare = 4;
+    ElasticPool pool(cfg);
+    print_metrics("start", pool.metrics());
+
+    // 1) Burst of latency-bound jobs (5 ms of waiting each): the pool grows.
+    {
+        auto s = ElasticPool::clock_type::now();
+        std::vector<std::future<int>> futs;
+        for (int i = 0; i < 64; ++i)
+            futs.push_back(pool.submit([i]{ std::this_thread::sleep_for(5ms); return i; }));
+        long sum = 0;
+        for (auto& f : futs) sum += f.get();
+        auto e = ElasticPool::clock_type::now();
+        print_metrics("after burst", pool.metrics());
+        std::cout << "    64 x 5ms jobs in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count()
+                  << " ms (sum " << sum << "; one fixed worker would need 320 ms)\n";
+    }
+
+    // 2) Quiet period: extra workers retire after keep_alive.
+    std::this_thread::sleep_for(300ms);
+    print_metrics("after idle", pool.metrics());
+
+    // 3) Jobs that block on other jobs. At max_workers they would deadlock;
+    //    BlockingScope lets spare workers run the children.
+    {
+        std::vector<std::future<int>> parents;
+        for (int i = 0; i < 10; ++i)
+            parents.push_back(pool.submit([&pool, i]{
+                auto child = pool.submit([i]{ return i * i; });
+                ElasticPool::BlockingScope blocked;
+                return child.get();
+            }));
+        int sum = 0;
+        for (auto& f : parents) sum += f.get();
+        print_metrics("after blocking jobs", pool.metrics());
+        std::cout << "    sum of squares 0..9 = " << sum << "\n";
+    }
+
+    std::cout << "  resize log:\n";
+    for (const auto& ev : pool.recent_events()) {
+        std::cout << "    +" << std::setw(4) << ms_since(ev.when) << " ms  " << std::left
+                  << std::setw(20) << kind_name(ev.kind) << std::right << " live -> " << ev.live_after;
+        if (ev.kind == ResizeEvent::Kind::GrowWait)
+            std::cout << " (oldest job waited " << ev.queue_wait.count() << " us)";
+        std::cout << "\n";
+    }
+}
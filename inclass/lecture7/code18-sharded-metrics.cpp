@@ -0,0 +1,223 @@
+// sharded_metrics.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code18-sharded-metrics.cpp -o code18
+//
+// README Phase 5A puts std::atomic<int> tasksSubmitted/tasksCompleted in the
+// pool. Every worker then writes the same cache line, and that line bounces
+// between cores on each job (lecture6/code3-compare.cpp shows the cost).
+// Here the metrics are sharded:
+//   - ShardedCounter / ShardedGauge hold one cache-line-padded slot per shard
+//   - each thread is given its own shard the first time it touches a metric,
+//     so writers never share a line as long as threads <= shards
+//   - writes are relaxed fetch_adds on the writer's own line; value() sums the
+//     shards, and that read is the only place that touches them all
+// A read taken while writers are running is only an approximate snapshot:
+// the shards are read one after another, so the sum can include an update on
+// a later shard and miss an earlier one. A gauge can therefore be transiently
+// off, even negative. The pool's in_flight is instead submitted - completed,
+// with completed read first (see stats()), which can never go negative.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ---------------- Sharded metrics ----------------
+namespace metrics {
+
+constexpr std::size_t kCacheLine = 64;
+constexpr std::size_t kShards = 64;             // power of two
+
+// Shard of the calling thread: threads are numbered in first-use order.
+inline std::size_t shard_index() {
+    static std::atomic<std::size_t> next{0};
+    thread_local const std::size_t idx = next.fetch_add(1, std::memory_order_relaxed) & (kShards - 1);
+    return idx;
+}
+
+class ShardedCounter {
+public:
+    ShardedCounter() = default;
+    ShardedCounter(const ShardedCounter&) = delete;
+    ShardedCounter& operator=(const ShardedCounter&) = delete;
+
+    // Relaxed by default; release/acquire let a reader order two counters.
+    void add(std::int64_t n = 1, std::memory_order mo = std::memory_order_relaxed) noexcept {
+        shards_[shard_index()].v.fetch_add(n, mo);
+    }
+
+    std::int64_t value(std::memory_order mo = std::memory_order_relaxed) const noexcept {
+        std::int64_t sum = 0;
+        for (const auto& s : shards_) sum += s.v.load(mo);
+        return sum;
+    }
+
+private:
+    struct alignas(kCacheLine) Shard {
+        std::atomic<std::int64_t> v{0};
+    };
+    Shard shards_[kShards];
+};
+
+// Up/down value such as queue depth. A gauge built from deltas cannot
+// support set(); anything that needs set() is written by one thread anyway.
+// value() is approximate while writers run: an inc() and its dec() may land
+// on different shards, and the reader can see the dec() without the inc().
+class ShardedGauge {
+public:
+    void inc(std::int64_t n = 1) noexcept { sum_.add(n); }
+    void dec(std::int64_t n = 1) noexcept { sum_.add(-n); }
+    std::int64_t value() const noexcept { return sum_.value(); }
+
+private:
+    ShardedCounter sum_;
+};
+
+} // namespace metrics
+
+// ---------------- ThreadPool with Phase 5A metrics ----------------
+struct PoolStats {
+    std::int64_t submitted;
+    std::int64_t completed;
+    std::int64_t in_flight;     // submitted, not finished
+};
+
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                    completed_.add(1, std::memory_order_release);
+                }
+            });
+        }
+    }
+
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.emplace([pkg]{ (*pkg)(); });
+            submitted_.add();           // happens-before the job's completed_.add()
+        }
+        cv_.notify_one();
+        return fut;
+    }
+
+    std::int64_t tasks_submitted() const { return submitted_.value(); }
+    std::int64_t tasks_completed() const { return completed_.value(); }
+
+    PoolStats stats() const {
+        // completed first, with acquire: every completion seen was submitted
+        // earlier, so the later submitted read includes it and in_flight >= 0.
+        std::int64_t completed = completed_.value(std::memory_order_acquire);
+        std::int64_t submitted = submitted_.value();
+        return {submitted, completed, submitted - completed};
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+
+    metrics::ShardedCounter submitted_, completed_;
+};
+
+// ---------------- Demo / benchmark ----------------
+using clock_type = std::chrono::steady_clock;
+
+// THREADS threads hammer one counter; same shape as lecture6/code3-compare.
+template<class Inc, class Read>
+long long hammer(int threads, int n, Inc inc, Read read) {
+    auto s = clock_type::now();
+    std::vector<std::thread> ts;
+    for (int t = 0; t < threads; ++t)
+        ts.emplace_back([&]{ for (int i = 0; i < n; ++i) inc(); });
+    for (auto& th : ts) th.join();
+    auto e = clock_type::now();
+    if (read() != static_cast<long long>(threads) * n) std::cerr << "wrong: " << read() << "\n";
+    return std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count();
+}
+
+int main() {
+    // README 5A: watch the counters while work runs.
+    {
+        ThreadPool pool(8);
+        std::vector<std::future<long>> futs;
+        for (int i = 0; i < 4000; ++i)
+            futs.push_back(pool.submit([i]{
+                long s = 0;
+                for (int k = 0; k < 20000; ++k) s += k ^ i;
+                return s;
+            }));
+        for (int tick = 0; tick < 4; ++tick) {
+            PoolStats s = pool.stats();
+            std::cout << "submitted " << s.submitted << ", completed " << std::setw(4) << s.completed
+                      << ", in flight " << s.in_flight << "\n";
+            futs[1000 * tick + 999].wait();
+        }
+        for (auto& f : futs) f.get();
+        while (pool.tasks_completed() != pool.tasks_submitted()) std::this_thread::yield();
+        PoolStats s = pool.stats();
+        std::cout << "final: submitted " << s.submitted << ", completed " << s.completed
+                  << ", in flight " << s.in_flight << "\n";
+    }
+
+    // One shared atomic vs the sharded counter, 8 threads.
+    const int THREADS = 8, N = 2'000'000;
+    std::atomic<long long> shared{0};
+    metrics::ShardedCounter sharded;
+    auto a = hammer(THREADS, N, [&]{ shared.fetch_add(1, std::memory_order_relaxed); },
+                    [&]{ return shared.load(); });
+    auto b = hammer(THREADS, N, [&]{ sharded.add(); }, [&]{ return sharded.value(); });
+    std::cout << "\n" << THREADS << " threads x " << N << " increments\n";
+    std::cout << "  shared atomic:   " << a << " ms\n";
+    std::cout << "  sharded counter: " << b << " ms\n";
+}
@@ -0,0 +1,419 @@
+// job_result_cache.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code19-memo.cpp -o code19
+//
+// Opt-in memoization for README jobs:
+//   - a Job that can be cached returns a JobKey (type id + parameters) from
+//     key(); jobs without one always run
+//   - ResultCache is split into stripes by key hash; each stripe is a fixed
+//     set of slots with CLOCK eviction (a referenced bit instead of an LRU
+//     list, so a hit does not reorder anything)
+//   - hits take the stripe's lock shared, so readers do not block each other
+//   - single-flight: while a key is being computed, identical requests
+//     share its future instead of queueing another copy of the job
+//   - only successful results are cached
+// JobEngine puts the cache in front of the pool. Counters: hits, misses,
+// coalesced (joined an in-flight computation), evictions.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ---------------- ThreadPool (as in code1) ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.emplace([pkg]{ (*pkg)(); });
+        }
+        cv_.notify_one();
+        return fut;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- Jobs ----------------
+struct JobResult {
+    bool success;
+    std::string message;
+    std::int64_t value;
+};
+
+// Identity of a deterministic job: same key, same result.
+struct JobKey {
+    std::uint32_t type;
+    std::int64_t a, b;
+
+    bool operator==(const JobKey& o) const { return type == o.type && a == o.a && b == o.b; }
+};
+
+struct JobKeyHash {
+    // splitmix64 finalizer per field, so every output bit depends on every
+    // input bit (ResultCache picks the stripe from the high bits).
+    static std::uint64_t mix(std::uint64_t x) noexcept {
+        x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ull;
+        x ^= x >> 27; x *= 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+    std::size_t operator()(const JobKey& k) const noexcept {
+        std::uint64_t h = mix(k.type);
+        h = mix(h ^ static_cast<std::uint64_t>(k.a));
+        h = mix(h ^ static_cast<std::uint64_t>(k.b));
+        return static_cast<std::size_t>(h);
+    }
+};
+
+class Job {
+public:
+    virtual ~Job() = default;
+    virtual JobResult run() = 0;
+    // Jobs opt in to caching by returning a key.
+    virtual std::optional<JobKey> key() const { return std::nullopt; }
+};
+
+enum JobType : std::uint32_t { kSumRange = 1, kPrimeCount = 2 };
+
+class SumRangeJob : public Job {
+public:
+    SumRangeJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        std::int64_t s = 0;
+        for (std::int64_t i = l_; i <= r_; ++i) s += i;
+        return {true, "OK", s};
+    }
+    std::optional<JobKey> key() const override { return JobKey{kSumRange, l_, r_}; }
+
+private:
+    std::int64_t l_, r_;
+};
+
+class PrimeCountJob : public Job {
+public:
+    PrimeCountJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        if (l_ > r_) return {false, "Failed: empty range", 0};
+        std::int64_t n = 0;
+        for (std::int64_t x = std::max<std::int64_t>(l_, 2); x <= r_; ++x) {
+            bool prime = true;
+            for (std::int64_t d = 2; d * d <= x; ++d) if (x % d == 0) { prime = false; break; }
+            n += prime;
+        }
+        return {true, "OK", n};
+    }
+    std::optional<JobKey> key() const override { return JobKey{kPrimeCount, l_, r_}; }
+
+private:
+    std::int64_t l_, r_;
+};
+
+// ---------------- ResultCache ----------------
+struct CacheStats {
+    std::uint64_t hits, misses, coalesced, evictions;
+    std::size_t size;
+};
+
+class ResultCache {
+public:
+    explicit ResultCache(std::size_t capacity, std::size_t stripes = 16)
+    : stripes_(std::max<std::size_t>(1, stripes)) {
+        std::size_t per = std::max<std::size_t>(1, (capacity + stripes_.size() - 1) / stripes_.size());
+        for (auto& s : stripes_) s.slots = std::vector<Slot>(per);
+    }
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Cached result, or nullopt. Shared lock only.
+    std::optional<JobResult> lookup(const JobKey& k) {
+        Stripe& s = stripe(k);
+        std::shared_lock<std::shared_mutex> lk(s.m);
+        auto it = s.index.find(k);
+        if (it == s.index.end()) return std::nullopt;
+        Slot& slot = s.slots[it->second];
+        slot.referenced.store(true, std::memory_order_relaxed);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return slot.result;
+    }
+
+    // Hit: a ready future. Computation already running for k: its future.
+    // Otherwise launch(complete) is called once and must arrange for
+    // complete(result) to run; everyone who asks meanwhile shares the future.
+    template<class Launch>
+    std::shared_future<JobResult> get_or_compute(const JobKey& k, Launch&& launch) {
+        if (auto hit = lookup(k)) return ready(std::move(*hit));
+
+        Stripe& s = stripe(k);
+        auto prom = std::make_shared<std::promise<JobResult>>();
+        std::shared_future<JobResult> fut;
+        {
+            std::unique_lock<std::shared_mutex> lk(s.m);
+            if (auto it = s.index.find(k); it != s.index.end()) {     // filled meanwhile
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                s.slots[it->second].referenced.store(true, std::memory_order_relaxed);
+                return ready(s.slots[it->second].result);
+            }
+            if (auto it = s.inflight.find(k); it != s.inflight.end()) {
+                coalesced_.fetch_add(1, std::memory_order_relaxed);
+                return it->second;
+            }
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            fut = prom->get_future().share();
+            s.inflight.emplace(k, fut);
+        }
+
+        // Publish: cache first, then drop the in-flight entry, then wake
+        // waiters, so no request can miss both and start a second run.
+        // If every copy of complete is destroyed without being called (the
+        // job threw past it, or its task was dropped), the guard still
+        // erases the entry and fails the waiters, so k can be computed again.
+        auto guard = std::make_shared<InflightGuard>(*this, k, prom);
+        auto complete = [this, k, guard](JobResult r) {
+            if (guard->done.exchange(true)) return;             // completed already
+            {
+                Stripe& st = stripe(k);
+                std::unique_lock<std::shared_mutex> lk(st.m);
+                if (r.success) insert_locked(st, k, r);
+                st.inflight.erase(k);
+            }
+            guard->prom->set_value(std::move(r));
+        };
+        launch(std::move(complete));        // if this throws, the guard cleans up
+        return fut;
+    }
+
+    CacheStats stats() const {
+        std::size_t size = 0;
+        for (const auto& s : stripes_) {
+            std::shared_lock<std::shared_mutex> lk(s.m);
+            size += s.index.size();
+        }
+        return {hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed),
+                coalesced_.load(std::memory_order_relaxed), evictions_.load(std::memory_order_relaxed),
+                size};
+    }
+
+private:
+    struct InflightGuard {
+        InflightGuard(ResultCache& c, const JobKey& k, std::shared_ptr<std::promise<JobResult>> p)
+        : cache(c), key(k), prom(std::move(p)) {}
+        ~InflightGuard() {
+            if (done.exchange(true)) return;
+            {
+                Stripe& st = cache.stripe(key);
+                std::unique_lock<std::shared_mutex> lk(st.m);
+                st.inflight.erase(key);
+            }
+            prom->set_exception(std::make_exception_ptr(
+                std::runtime_error("job finished without a result")));
+        }
+
+        ResultCache& cache;
+        JobKey key;
+        std::shared_ptr<std::promise<JobResult>> prom;
+        std::atomic<bool> done{false};
+    };
+
+    struct Slot {
+        bool used = false;
+        std::atomic<bool> referenced{false};     // set by readers under the shared lock
+        JobKey key{};
+        JobResult result{};
+    };
+
+    struct Stripe {
+        mutable std::shared_mutex m;
+        std::vector<Slot> slots;
+        std::unordered_map<JobKey, std::size_t, JobKeyHash> index;
+        std::unordered_map<JobKey, std::shared_future<JobResult>, JobKeyHash> inflight;
+        std::size_t hand = 0;
+    };
+
+    Stripe& stripe(const JobKey& k) {
+        // High bits: the low ones also pick the bucket inside the stripe's map.
+        return stripes_[(JobKeyHash{}(k) >> 32) % stripes_.size()];
+    }
+
+    static std::shared_future<JobResult> ready(JobResult r) {
+        std::promise<JobResult> p;
+        p.set_value(std::move(r));
+        return p.get_future().share();
+    }
+
+    // CLOCK: sweep from the hand, clearing referenced bits, and take the
+    // first unused or unreferenced slot.
+    void insert_locked(Stripe& s, const JobKey& k, const JobResult& r) {
+        if (auto it = s.index.find(k); it != s.index.end()) {
+            s.slots[it->second].result = r;
+            return;
+        }
+        for (;;) {
+            Slot& slot = s.slots[s.hand];
+            std::size_t idx = s.hand;
+            s.hand = (s.hand + 1) % s.slots.size();
+            if (slot.used && slot.referenced.exchange(false, std::memory_order_relaxed)) continue;
+            if (slot.used) {
+                s.index.erase(slot.key);
+                evictions_.fetch_add(1, std::memory_order_relaxed);
+            }
+            slot.used = true;
+            slot.key = k;
+            slot.result = r;
+            slot.referenced.store(false, std::memory_order_relaxed);
+            s.index.emplace(k, idx);
+            return;
+        }
+    }
+
+    std::vector<Stripe> stripes_;
+    std::atomic<std::uint64_t> hits_{0}, misses_{0}, coalesced_{0}, evictions_{0};
+};
+
+// ---------------- JobEngine ----------------
+class JobEngine {
+public:
+    // cache == nullptr: every job runs (the original behaviour).
+    JobEngine(ThreadPool& pool, ResultCache* cache = nullptr) : pool_(pool), cache_(cache) {}
+
+    std::shared_future<JobResult> submit(std::shared_ptr<Job> job) {
+        std::optional<JobKey> k = cache_ ? job->key() : std::nullopt;
+        if (!k) return pool_.submit([job]{ return job->run(); }).share();
+        return cache_->get_or_compute(*k, [this, job](auto complete) {
+            pool_.submit([job, complete = std::move(complete)]() mutable {
+                JobResult r;
+                try { r = job->run(); }
+                catch (const std::exception& e) { r = {false, std::string("Failed: ") + e.what(), 0}; }
+                catch (...) { r = {false, "Failed: unknown exception", 0}; }
+                complete(std::move(r));
+            });
+        });
+    }
+
+private:
+    ThreadPool& pool_;
+    ResultCache* cache_;
+};
+
+// ---------------- Demo ----------------
+using clock_type = std::chrono::steady_clock;
+
+// Clients asking for a small set of popular ranges, plus some one-offs.
+// Each client waits for one answer before sending the next request.
+double run_clients(JobEngine& engine, int clients, int requests, std::int64_t& checksum) {
+    auto s = clock_type::now();
+    std::vector<std::thread> ts;
+    std::vector<std::int64_t> sums(clients, 0);
+    for (int c = 0; c < clients; ++c)
+        ts.emplace_back([&, c]{
+            for (int i = 0; i < requests; ++i) {
+                std::shared_future<JobResult> f;
+                std::int64_t hot = (i * 7 + c) % 8;                      // 8 popular ranges
+                if (i % 10 == 9)
+                    f = engine.submit(std::make_shared<SumRangeJob>(1, 100000 + c * 1000 + i));
+                else if (i % 2)
+                    f = engine.submit(std::make_shared<PrimeCountJob>(1, 20000 + hot * 1000));
+                else
+                    f = engine.submit(std::make_shared<SumRangeJob>(1, 1000000 + hot));
+                sums[c] += f.get().value;
+            }
+        });
+    for (auto& t : ts) t.join();
+    checksum = 0;
+    for (auto v : sums) checksum += v;
+    return std::chrono::duration<double, std::milli>(clock_type::now() - s).count();
+}
+
+int main() {
+    ThreadPool pool(4);
+
+    std::int64_t plain_sum = 0, cached_sum = 0;
+    JobEngine plain(pool);
+    double t_plain = run_clients(plain, 4, 200, plain_sum);
+
+    ResultCache cache(64);
+    JobEngine cached(pool, &cache);
+    double t_cached = run_clients(cached, 4, 200, cached_sum);
+
+    std::cout << "no cache:   " << t_plain << " ms\n";
+    std::cout << "with cache: " << t_cached << " ms"
+              << (plain_sum == cached_sum ? " (same results)" : " (RESULTS DIFFER)") << "\n";
+    CacheStats s = cache.stats();
+    std::cout << "  hits " << s.hits << ", misses " << s.misses << ", coalesced " << s.coalesced
+              << ", evictions " << s.evictions << ", size " << s.size << "\n";
+
+    // Single-flight: 50 identical requests at once run the job once.
+    ResultCache fresh(16);
+    JobEngine engine(pool, &fresh);
+    std::vector<std::shared_future<JobResult>> futs;
+    for (int i = 0; i < 50; ++i) futs.push_back(engine.submit(std::make_shared<PrimeCountJob>(1, 300000)));
+    for (auto& f : futs) f.wait();
+    s = fresh.stats();
+    std::cout << "50 identical PrimeCountJob(1, 300000) = " << futs[0].get().value
+              << ": misses " << s.misses << ", coalesced " << s.coalesced << ", hits " << s.hits << "\n";
+
+    // Failures are not cached.
+    auto bad = engine.submit(std::make_shared<PrimeCountJob>(10, 1)).get();
+    auto again = engine.submit(std::make_shared<PrimeCountJob>(10, 1)).get();
+    std::cout << "empty range twice: \"" << bad.message << "\", misses now " << fresh.stats().misses
+              << (again.success ? "" : " (not cached)") << "\n";
+}
@@ -0,0 +1,448 @@
+// range_blocks.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code20-blocks.cpp -o code20
+//
+// Overlapping range queries ([1, 1e6], then [1, 1.2e6], ...) recompute the
+// same numbers again and again. RangeEngine splits the number line into
+// fixed, aligned blocks of kBlock integers:
+//
+//        l                                                    r
+//        |  edge  | block b | block b+1 |  ...  | block e |  edge  |
+//
+//   - a full block's partial result is computed once and kept in a map of
+//     shared_futures; the future is both the cache entry and the single-flight
+//     marker, so two queries needing the same block share one computation
+//   - the map holds at most max_blocks entries, evicted with CLOCK as in
+//     code19; a block whose kernel throws is dropped, so it is retried
+//   - missing blocks are submitted to the pool together and run in parallel
+//   - the two partial edges are computed directly (at most 2 * kBlock numbers)
+//   - while a query waits for its blocks it runs queued pool tasks, so
+//     calling query() from inside a pool task cannot starve the pool
+// A repeated or extended query costs O(blocks) lookups plus the edges.
+// The kernel is a template parameter: PrimeCountKernel (segmented sieve per
+// block) and SumKernel are provided; partial results must be additive.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ---------------- ThreadPool (as in code1) ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.emplace([pkg]{ (*pkg)(); });
+        }
+        cv_.notify_one();
+        return fut;
+    }
+
+    // Runs one queued task on the calling thread; false if there was none.
+    bool run_one() {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (q_.empty()) return false;
+            task = std::move(q_.front());
+            q_.pop();
+        }
+        try { task(); } catch (...) { /* swallow/log */ }
+        return true;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- Kernels ----------------
+// Number of primes in [lo, hi], sieving just that window.
+struct PrimeCountKernel {
+    static constexpr const char* name = "prime count";
+
+    std::int64_t operator()(std::int64_t lo, std::int64_t hi) const {
+        lo = std::max<std::int64_t>(lo, 2);
+        if (hi < lo) return 0;
+        auto base = base_primes(isqrt(hi));
+        std::vector<char> composite(static_cast<std::size_t>(hi - lo + 1), 0);
+        for (std::int64_t p : *base) {
+            if (p * p > hi) break;
+            std::int64_t start = std::max(p * p, (lo + p - 1) / p * p);
+            for (std::int64_t n = start; n <= hi; n += p) composite[n - lo] = 1;
+        }
+        return std::count(composite.begin(), composite.end(), 0);
+    }
+
+private:
+    static std::int64_t isqrt(std::int64_t x) {
+        auto s = static_cast<std::int64_t>(std::sqrt(static_cast<double>(x)));
+        while (s * s > x) --s;
+        while ((s + 1) * (s + 1) <= x) ++s;
+        return s;
+    }
+
+    // Primes <= limit; grows by doubling, callers keep their snapshot (as code9).
+    static std::shared_ptr<const std::vector<std::int64_t>> base_primes(std::int64_t limit) {
+        static std::mutex m;
+        static std::shared_ptr<const std::vector<std::int64_t>> table;
+        static std::int64_t table_limit = 0;
+        std::lock_guard<std::mutex> lk(m);
+        if (table && table_limit >= limit) return table;
+        std::int64_t n = std::max<std::int64_t>({limit, table_limit * 2, 1024});
+        std::vector<char> composite(n + 1, 0);
+        auto primes = std::make_shared<std::vector<std::int64_t>>();
+        for (std::int64_t i = 2; i <= n; ++i) {
+            if (composite[i]) continue;
+            primes->push_back(i);
+            for (std::int64_t j = i * i; j <= n; j += i) composite[j] = 1;
+        }
+        table = std::move(primes);
+        table_limit = n;
+        return table;
+    }
+};
+
+// Sum of lo..hi, the README loop.
+struct SumKernel {
+    static constexpr const char* name = "sum";
+
+    std::int64_t operator()(std::int64_t lo, std::int64_t hi) const {
+        std::int64_t s = 0;
+        for (std::int64_t i = lo; i <= hi; ++i) s += i;
+        return s;
+    }
+};
+
+// ---------------- RangeEngine ----------------
+struct RangeStats {
+    std::uint64_t queries;
+    std::uint64_t blocks_reused;      // already cached or in flight
+    std::uint64_t blocks_computed;
+    std::uint64_t edge_numbers;       // integers handled outside full blocks
+    std::size_t cached_blocks;
+    std::uint64_t evictions;
+};
+
+template<class Kernel>
+class RangeEngine {
+public:
+    static constexpr std::int64_t kBlock = 1 << 16;
+
+    explicit RangeEngine(ThreadPool& pool, Kernel kernel = {}, std::size_t max_blocks = 4096)
+    : pool_(pool), kernel_(kernel), slots_(std::max<std::size_t>(max_blocks, 1)) {}
+
+    // Queued and running blocks point back here: wait them out, helping in
+    // case this is one of pool_'s workers.
+    ~RangeEngine() {
+        while (pending() && pool_.run_one()) {}
+        std::unique_lock<std::mutex> lk(drain_m_);
+        drain_cv_.wait(lk, [this]{ return running_ == 0; });
+    }
+
+    // Kernel result over [l, r]; 0 for an empty range.
+    std::int64_t query(std::int64_t l, std::int64_t r) {
+        queries_.fetch_add(1, std::memory_order_relaxed);
+        if (l > r) return 0;
+        const std::int64_t first = ceil_div(l, kBlock);              // first full block
+        const std::int64_t last = floor_div(r + 1, kBlock) - 1;      // last full block
+        if (first > last) return edge(l, r);
+
+        // Start every missing block before waiting on any of them.
+        std::vector<std::shared_future<std::int64_t>> parts;
+        parts.reserve(static_cast<std::size_t>(last - first + 1));
+        for (std::int64_t b = first; b <= last; ++b) parts.push_back(block(b));
+
+        // Every part is waited for, even after one has failed, so a query
+        // never returns while its blocks are still at work.
+        std::exception_ptr error;
+        std::int64_t total = 0;
+        try {
+            total = edge(l, first * kBlock - 1) + edge((last + 1) * kBlock, r);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (auto& f : parts) {
+            // Help instead of blocking: on a worker, the block may be queued
+            // behind this very task. A block that is not queued is running.
+            while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                if (!pool_.run_one()) { f.wait(); break; }
+            try {
+                total += f.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+        return total;
+    }
+
+    RangeStats stats() const {
+        std::shared_lock<std::shared_mutex> lk(m_);
+        return {queries_.load(std::memory_order_relaxed), reused_.load(std::memory_order_relaxed),
+                computed_.load(std::memory_order_relaxed), edge_numbers_.load(std::memory_order_relaxed),
+                index_.size(), evictions_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    static std::int64_t floor_div(std::int64_t a, std::int64_t b) {
+        return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+    }
+    static std::int64_t ceil_div(std::int64_t a, std::int64_t b) { return -floor_div(-a, b); }
+
+    std::int64_t edge(std::int64_t lo, std::int64_t hi) {
+        if (lo > hi) return 0;
+        edge_numbers_.fetch_add(static_cast<std::uint64_t>(hi - lo + 1), std::memory_order_relaxed);
+        return kernel_(lo, hi);
+    }
+
+    // Cached (or in-flight) partial for block b; submits it if missing.
+    std::shared_future<std::int64_t> block(std::int64_t b) {
+        {
+            std::shared_lock<std::shared_mutex> lk(m_);
+            auto it = index_.find(b);
+            if (it != index_.end()) {
+                Slot& slot = slots_[it->second];
+                slot.referenced.store(true, std::memory_order_relaxed);
+                reused_.fetch_add(1, std::memory_order_relaxed);
+                return slot.fut;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lk(m_);
+        auto it = index_.find(b);
+        if (it != index_.end()) {
+            reused_.fetch_add(1, std::memory_order_relaxed);
+            return slots_[it->second].fut;
+        }
+        computed_.fetch_add(1, std::memory_order_relaxed);
+        Kernel k = kernel_;
+        const std::uint64_t ticket = ++tickets_;
+        { std::lock_guard<std::mutex> dl(drain_m_); ++running_; }
+        std::shared_future<std::int64_t> fut;
+        try {
+            fut = pool_.submit([this, k, b, ticket]{
+                try {
+                    std::int64_t v = k(b * kBlock, (b + 1) * kBlock - 1);
+                    finished();
+                    return v;
+                } catch (...) {
+                    forget(b, ticket);      // waiters still see the exception; the next query retries
+                    finished();
+                    throw;
+                }
+            }).share();
+        } catch (...) {
+            finished();
+            throw;
+        }
+        insert_locked(b, ticket, fut);
+        return fut;
+    }
+
+    bool pending() {
+        std::lock_guard<std::mutex> lk(drain_m_);
+        return running_ > 0;
+    }
+
+    // A block's last touch of *this. Notifies under the lock, so the
+    // destructor cannot return (and free drain_cv_) before notify_all does.
+    void finished() {
+        std::lock_guard<std::mutex> lk(drain_m_);
+        if (--running_ == 0) drain_cv_.notify_all();
+    }
+
+    // Drops block b if it is still the computation identified by ticket.
+    void forget(std::int64_t b, std::uint64_t ticket) {
+        std::unique_lock<std::shared_mutex> lk(m_);
+        auto it = index_.find(b);
+        if (it == index_.end() || slots_[it->second].ticket != ticket) return;
+        slots_[it->second] = Slot{};
+        index_.erase(it);
+    }
+
+    // CLOCK, as in code19: sweep from the hand, clearing referenced bits, and
+    // take the first unused or unreferenced slot. An evicted block that is
+    // still running finishes for whoever holds its future.
+    void insert_locked(std::int64_t b, std::uint64_t ticket, std::shared_future<std::int64_t> fut) {
+        for (;;) {
+            Slot& slot = slots_[hand_];
+            std::size_t idx = hand_;
+            hand_ = (hand_ + 1) % slots_.size();
+            if (slot.used && slot.referenced.exchange(false, std::memory_order_relaxed)) continue;
+            if (slot.used) {
+                index_.erase(slot.block);
+                evictions_.fetch_add(1, std::memory_order_relaxed);
+            }
+            slot.used = true;
+            slot.block = b;
+            slot.ticket = ticket;
+            slot.fut = std::move(fut);
+            slot.referenced.store(false, std::memory_order_relaxed);
+            index_.emplace(b, idx);
+            return;
+        }
+    }
+
+    struct Slot {
+        bool used = false;
+        std::atomic<bool> referenced{false};     // set by readers under the shared lock
+        std::int64_t block = 0;
+        std::uint64_t ticket = 0;
+        std::shared_future<std::int64_t> fut;
+
+        Slot() = default;
+        Slot& operator=(Slot&& o) noexcept {
+            used = o.used;
+            referenced.store(o.referenced.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            block = o.block;
+            ticket = o.ticket;
+            fut = std::move(o.fut);
+            return *this;
+        }
+    };
+
+    ThreadPool& pool_;
+    Kernel kernel_;
+    mutable std::shared_mutex m_;
+    std::vector<Slot> slots_;
+    std::unordered_map<std::int64_t, std::size_t> index_;      // block -> slot
+    std::size_t hand_ = 0;
+    std::uint64_t tickets_ = 0;
+    std::mutex drain_m_;
+    std::condition_variable drain_cv_;
+    std::size_t running_ = 0;                                   // blocks submitted, not yet finished
+    std::atomic<std::uint64_t> queries_{0}, reused_{0}, computed_{0}, edge_numbers_{0}, evictions_{0};
+};
+
+// ---------------- Demo ----------------
+using clock_type = std::chrono::steady_clock;
+
+// Counts integers; the first `failures` blocks it is asked for throw.
+struct FlakyKernel {
+    std::shared_ptr<std::atomic<int>> failures;
+
+    std::int64_t operator()(std::int64_t lo, std::int64_t hi) const {
+        if (hi - lo + 1 >= (1 << 16) && failures->fetch_sub(1) > 0) throw std::runtime_error("flaky block");
+        return hi - lo + 1;
+    }
+};
+
+template<class Kernel>
+void run(ThreadPool& pool, const std::vector<std::pair<std::int64_t, std::int64_t>>& queries) {
+    RangeEngine<Kernel> engine(pool);
+    Kernel direct;
+    std::cout << Kernel::name << " (block = " << RangeEngine<Kernel>::kBlock << ")\n";
+    for (auto [l, r] : queries) {
+        auto s = clock_type::now();
+        std::int64_t got = engine.query(l, r);
+        auto m = clock_type::now();
+        std::int64_t want = direct(l, r);
+        auto e = clock_type::now();
+        RangeStats st = engine.stats();
+        std::cout << "  [" << std::setw(8) << l << ", " << std::setw(8) << r << "] = " << std::setw(13) << got
+                  << std::fixed << std::setprecision(2)
+                  << "  engine " << std::setw(7) << std::chrono::duration<double, std::milli>(m - s).count()
+                  << " ms, direct " << std::setw(7) << std::chrono::duration<double, std::milli>(e - m).count()
+                  << " ms" << (got == want ? "" : "  MISMATCH")
+                  << "  | blocks computed " << st.blocks_computed << ", reused " << st.blocks_reused << "\n";
+    }
+}
+
+int main() {
+    ThreadPool pool(4);
+    const std::vector<std::pair<std::int64_t, std::int64_t>> queries = {
+        {1, 1'000'000}, {1, 1'200'000}, {1, 1'000'000}, {500'000, 2'000'000},
+        {123'457, 1'987'654}, {1'000, 60'000}, {1, 20'000'000}, {1, 20'000'001}};
+    run<PrimeCountKernel>(pool, queries);
+    run<SumKernel>(pool, {{-3'000'000, 5'000'000}, {-3'000'000, 5'000'001}, {-70'000, 70'000}, {1, 4'000'000}});
+
+    // Querying from inside a pool task, on a one-worker pool with room for
+    // 8 blocks: the query runs its own blocks and evicts as it goes.
+    {
+        ThreadPool one(1);
+        RangeEngine<SumKernel> engine(one, {}, 8);
+        auto f = one.submit([&]{ return engine.query(1, 2'000'000) + engine.query(1, 2'000'000); });
+        std::int64_t got = f.get();
+        RangeStats st = engine.stats();
+        std::cout << "query inside a worker, 8-block cache: "
+                  << (got == 2 * SumKernel{}(1, 2'000'000) ? "correct" : "MISMATCH") << ", "
+                  << st.cached_blocks << " cached, " << st.evictions << " evictions\n";
+    }
+
+    // A failed block is not cached: the next query computes it again. The
+    // failing query still waits for its other blocks, and the last engine,
+    // whose every block fails, is destroyed straight after the first.
+    {
+        const std::int64_t r = (64 << 16) - 1;
+        RangeEngine<FlakyKernel> engine(pool, FlakyKernel{std::make_shared<std::atomic<int>>(3)});
+        try {
+            engine.query(0, r);
+        } catch (const std::exception& e) {
+            std::cout << "first query: " << e.what();
+        }
+        std::cout << "; retry = " << engine.query(0, r) << " (want " << r + 1 << ")\n";
+        try {
+            RangeEngine<FlakyKernel>(pool, FlakyKernel{std::make_shared<std::atomic<int>>(64)}).query(0, r);
+        } catch (const std::exception&) {
+        }
+    }
+}
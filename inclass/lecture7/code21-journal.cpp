@@ -0,0 +1,817 @@
+// job_journal.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code21-journal.cpp -o code21
+//
+// README Phase 3's BlockingJobQueue with an optional crash-recovery journal:
+//   - JobJournal is an append-only file of fixed 32-byte records, mmap'd
+//     whole: Submit{id, job type, params} when a job is queued, Complete{id}
+//     when a worker finishes it
+//   - producers reserve a slot with one fetch_add and write it in place; no
+//     lock, no syscall. A record's checksum is stored last, so a torn or
+//     never-written slot is recognisable after a crash
+//   - a flusher thread msyncs the newly written prefix every sync_interval
+//     (group commit: one msync covers every record since the last one);
+//     push_durable() waits for that instead of returning at once
+//   - on open, Submits without a Complete are replayed into the queue and the
+//     file is rewritten with just those (compaction), so it stays small
+//   - while running, the flusher does the same once a segment passes
+//     high_water: producers move to a fresh file and the live Submits are
+//     copied after them, so the journal never fills up. If that fails the
+//     journal warns and stops journaling; jobs keep flowing
+// main() fork()s a child that journals 1M jobs and is SIGKILLed part-way;
+// the parent then replays the journal and finishes the lost work. A second
+// child is killed in the middle of a rollover, with the log split across
+// two files.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// ---------------- Jobs ----------------
+struct JobResult {
+    bool success;
+    std::string message;
+    std::int64_t value;
+};
+
+enum class JobType : std::uint16_t { SumRange = 1, PrimeCount = 2 };
+
+// What the journal stores about a job: enough to rebuild it.
+struct JobSpec {
+    JobType type;
+    std::int64_t a, b;
+};
+
+class Job {
+public:
+    virtual ~Job() = default;
+    virtual JobResult run() = 0;
+    virtual JobSpec spec() const = 0;
+};
+
+class SumRangeJob : public Job {
+public:
+    SumRangeJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        if (l_ > r_) return {true, "OK", 0};
+        return {true, "OK", (l_ + r_) * (r_ - l_ + 1) / 2};
+    }
+    JobSpec spec() const override { return {JobType::SumRange, l_, r_}; }
+
+private:
+    std::int64_t l_, r_;
+};
+
+class PrimeCountJob : public Job {
+public:
+    PrimeCountJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        std::int64_t n = 0;
+        for (std::int64_t x = std::max<std::int64_t>(l_, 2); x <= r_; ++x) {
+            bool prime = true;
+            for (std::int64_t d = 2; d * d <= x; ++d) if (x % d == 0) { prime = false; break; }
+            n += prime;
+        }
+        return {true, "OK", n};
+    }
+    JobSpec spec() const override { return {JobType::PrimeCount, l_, r_}; }
+
+private:
+    std::int64_t l_, r_;
+};
+
+std::unique_ptr<Job> make_job(const JobSpec& s) {
+    switch (s.type) {
+        case JobType::SumRange:   return std::make_unique<SumRangeJob>(s.a, s.b);
+        case JobType::PrimeCount: return std::make_unique<PrimeCountJob>(s.a, s.b);
+    }
+    return nullptr;
+}
+
+// ---------------- JobJournal ----------------
+class JobJournal {
+public:
+    struct Options {
+        std::size_t capacity = 1u << 22;                    // records per segment (128 MB, sparse)
+        double high_water = 0.75;                           // roll over once a segment is this full
+        std::chrono::milliseconds sync_interval{10};
+    };
+
+    struct Replayed {
+        std::uint64_t id;
+        JobSpec spec;
+    };
+
+    struct ReplayStats {
+        std::size_t submits = 0, completes = 0, damaged = 0;
+        double ms = 0;
+    };
+
+    // submit()/complete() return this once journaling has been switched off.
+    static constexpr std::uint64_t kNotJournaled = UINT64_MAX;
+
+    // Opens (or creates) the journal; unfinished jobs end up in replayed().
+    JobJournal(std::string path, Options opt) : path_(std::move(path)), opt_(opt) {
+        auto s = std::chrono::steady_clock::now();
+        recover();
+        create_compacted();
+        stats_.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s).count();
+        flusher_ = std::thread([this]{ flush_loop(); });
+    }
+    explicit JobJournal(std::string path) : JobJournal(std::move(path), Options{}) {}
+
+    JobJournal(const JobJournal&) = delete;
+    JobJournal& operator=(const JobJournal&) = delete;
+
+    ~JobJournal() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        flush_cv_.notify_all();
+        roll_cv_.notify_all();
+        flusher_.join();
+        sync_now();
+    }
+
+    const std::vector<Replayed>& replayed() const { return replayed_; }
+    const ReplayStats& replay_stats() const { return stats_; }
+    std::uint64_t next_id() const { return next_id_; }
+
+    // Returns the record's position, for wait_durable().
+    std::uint64_t submit(std::uint64_t id, const JobSpec& s) {
+        return append(Kind::Submit, id, static_cast<std::uint16_t>(s.type), s.a, s.b);
+    }
+    std::uint64_t complete(std::uint64_t id) { return append(Kind::Complete, id, 0, 0, 0); }
+
+    // Blocks until the record at pos is on disk (the next group commit).
+    void wait_durable(std::uint64_t pos) {
+        if (pos == kNotJournaled) return;
+        std::unique_lock<std::mutex> lk(m_);
+        ++durable_waiters_;
+        flush_cv_.notify_one();
+        durable_cv_.wait(lk, [&]{ return durable_ > pos || stop_ || disabled_.load(); });
+        --durable_waiters_;
+    }
+
+    std::uint64_t syncs() const { return syncs_.load(std::memory_order_relaxed); }
+    std::uint64_t rollovers() const { return rollovers_.load(std::memory_order_relaxed); }
+    bool journaling() const { return !disabled_.load(std::memory_order_relaxed); }
+
+private:
+    enum class Kind : std::uint16_t { Submit = 1, Complete = 2, Pad = 3 };   // Pad: reserved slot left unused
+
+    struct Record {
+        std::uint32_t check;        // written last; 0 = slot never written
+        std::uint16_t kind;
+        std::uint16_t type;
+        std::uint64_t id;
+        std::int64_t a, b;
+    };
+    static_assert(sizeof(Record) == 32, "journal records are 32 bytes");
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t record_size;
+        std::uint64_t capacity;
+        std::uint64_t generation;   // +1 per compaction; tells a live .next from a stale one
+        std::uint64_t reserved;     // slots [0, reserved) are filled late, by a rollover
+    };
+    static constexpr std::size_t kHeaderBytes = 64;
+    static constexpr char kMagic[8] = {'J', 'O', 'B', 'J', 'R', 'N', 'L', '1'};
+    // Slots reserved but not yet written when the process died leave holes;
+    // past the header's reserved prefix there is at most one per producer
+    // that was mid-append, so recovery scans this far past the last record
+    // before concluding the log has ended.
+    static constexpr std::size_t kHoleWindow = 4096;
+
+    // One mmap'd journal file. Producers only touch tail and the mapping, and
+    // the struct outlives its mapping (see retired_), so a producer holding a
+    // stale pointer can still bump tail, see it is past capacity and retry.
+    struct Segment {
+        std::string path;
+        int fd = -1;
+        void* base = MAP_FAILED;
+        std::size_t bytes = 0;
+        std::size_t capacity = 0;
+        std::uint64_t first = 0;                // journal position of slot 0
+        std::uint64_t generation = 0;
+        std::atomic<std::uint64_t> tail{0};     // next free slot
+        std::uint64_t synced = 0;               // flusher-private: [0, synced) is on disk
+
+        Record* records() const { return reinterpret_cast<Record*>(static_cast<char*>(base) + kHeaderBytes); }
+        void unmap() {
+            if (base != MAP_FAILED) munmap(base, bytes);
+            if (fd >= 0) ::close(fd);
+            base = MAP_FAILED;
+            fd = -1;
+        }
+        ~Segment() { unmap(); }
+    };
+
+    struct Span {
+        const Record* recs;
+        std::size_t n;
+    };
+
+    static std::uint32_t checksum(const Record& r) {
+        std::uint64_t h = 0xcbf29ce484222325ull;
+        auto mixin = [&](std::uint64_t v) { h = (h ^ v) * 0x100000001b3ull; h ^= h >> 29; };
+        mixin(r.kind); mixin(r.type); mixin(r.id);
+        mixin(static_cast<std::uint64_t>(r.a)); mixin(static_cast<std::uint64_t>(r.b));
+        return static_cast<std::uint32_t>(h) | 1u;                     // never 0
+    }
+
+    std::uint64_t append(Kind kind, std::uint64_t id, std::uint16_t type, std::int64_t a, std::int64_t b) {
+        for (;;) {
+            if (disabled_.load(std::memory_order_relaxed)) return kNotJournaled;
+            Segment* seg = cur_.load(std::memory_order_acquire);
+            std::uint64_t pos = seg->tail.fetch_add(1, std::memory_order_relaxed);
+            if (pos < seg->capacity) {
+                write(*seg, pos, kind, id, type, a, b);
+                return seg->first + pos;
+            }
+            if (!wait_for_rollover(seg)) return kNotJournaled;
+        }
+    }
+
+    static void write(Segment& seg, std::uint64_t pos, Kind kind, std::uint64_t id, std::uint16_t type,
+                      std::int64_t a, std::int64_t b) {
+        Record r{0, static_cast<std::uint16_t>(kind), type, id, a, b};
+        Record* slot = &seg.records()[pos];
+        std::memcpy(reinterpret_cast<char*>(slot) + 4, reinterpret_cast<const char*>(&r) + 4, sizeof(Record) - 4);
+        __atomic_store_n(&slot->check, checksum(r), __ATOMIC_RELEASE);
+    }
+
+    // The segment is full or sealed: wake the flusher and wait for the next one.
+    bool wait_for_rollover(Segment* seg) {
+        std::unique_lock<std::mutex> lk(m_);
+        roll_wanted_ = true;
+        flush_cv_.notify_one();
+        roll_cv_.wait(lk, [&]{ return cur_.load() != seg || disabled_.load() || stop_; });
+        return !stop_;
+    }
+
+    // Stops journaling for good; the job path carries on without it.
+    void disable(const std::string& why) {
+        if (disabled_.exchange(true)) return;
+        std::cerr << "warning: journal " << path_ << ": " << why << "; no longer journaling jobs\n";
+        { std::lock_guard<std::mutex> lk(m_); }
+        roll_cv_.notify_all();
+        durable_cv_.notify_all();
+    }
+
+    // Submits in spans with no Complete in any of them, oldest first. A job
+    // copied forward by a rollover can appear twice; it is returned once.
+    static std::vector<Replayed> unfinished(const std::vector<Span>& spans, ReplayStats* st) {
+        std::vector<std::uint64_t> done;
+        std::vector<Replayed> out;
+        for (const Span& s : spans)
+            for (std::size_t i = 0; i < s.n; ++i) {
+                const Record& r = s.recs[i];
+                std::uint32_t c = __atomic_load_n(&r.check, __ATOMIC_ACQUIRE);
+                if (c == 0) continue;
+                if (c != checksum(r)) { if (st) ++st->damaged; continue; }
+                if (r.kind == static_cast<std::uint16_t>(Kind::Complete)) {
+                    done.push_back(r.id);
+                    if (st) ++st->completes;
+                } else if (r.kind == static_cast<std::uint16_t>(Kind::Submit)) {
+                    out.push_back({r.id, {static_cast<JobType>(r.type), r.a, r.b}});
+                    if (st) ++st->submits;
+                }
+            }
+        std::sort(done.begin(), done.end());
+        std::stable_sort(out.begin(), out.end(), [](const Replayed& x, const Replayed& y) { return x.id < y.id; });
+        out.erase(std::unique(out.begin(), out.end(), [](const Replayed& x, const Replayed& y) { return x.id == y.id; }),
+                  out.end());
+        out.erase(std::remove_if(out.begin(), out.end(), [&](const Replayed& r) {
+                      return std::binary_search(done.begin(), done.end(), r.id);
+                  }), out.end());
+        return out;
+    }
+
+    // ---- recovery ----
+    struct MappedLog {
+        void* p = MAP_FAILED;
+        std::size_t bytes = 0;
+        std::uint64_t generation = 0;
+        Span span{nullptr, 0};
+    };
+
+    // Maps a journal file read-only and finds where its log ends.
+    bool map_log(const std::string& path, MappedLog& m) const {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || static_cast<std::size_t>(st.st_size) < kHeaderBytes) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap journal");
+        madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+        const auto* hdr = static_cast<const Header*>(p);
+        static constexpr char kBlank[8] = {};
+        if (std::memcmp(hdr->magic, kBlank, 8) == 0) {  // died between creating a segment and writing its header
+            munmap(p, st.st_size);
+            return false;
+        }
+        if (std::memcmp(hdr->magic, kMagic, 8) != 0 || hdr->record_size != sizeof(Record)) {
+            munmap(p, st.st_size);
+            throw std::runtime_error("not a job journal: " + path);
+        }
+        const auto* recs = reinterpret_cast<const Record*>(static_cast<const char*>(p) + kHeaderBytes);
+        const std::size_t n = std::min<std::size_t>(hdr->capacity, (st.st_size - kHeaderBytes) / sizeof(Record));
+        std::size_t end = 0;
+        for (std::size_t i = 0, gap = 0; i < n && gap < kHoleWindow; ++i) {
+            if (recs[i].check == 0) { gap += i >= hdr->reserved; continue; }
+            gap = 0;
+            end = i + 1;
+        }
+        m = {p, static_cast<std::size_t>(st.st_size), hdr->generation, {recs, end}};
+        return true;
+    }
+
+    // A crash mid-rollover leaves the log split between path and path.next,
+    // the latter one generation newer; otherwise a .next is a leftover.
+    void recover() {
+        std::vector<MappedLog> logs;
+        MappedLog m;
+        if (map_log(path_, m)) logs.push_back(m);
+        if (map_log(path_ + ".next", m)) {
+            if (logs.empty() || m.generation == logs[0].generation + 1) logs.push_back(m);
+            else munmap(m.p, m.bytes);
+        }
+        std::vector<Span> spans;
+        for (const auto& l : logs) {
+            spans.push_back(l.span);
+            generation_ = std::max(generation_, l.generation);
+            for (std::size_t i = 0; i < l.span.n; ++i)
+                if (l.span.recs[i].check != 0 && l.span.recs[i].check == checksum(l.span.recs[i]))
+                    next_id_ = std::max(next_id_, l.span.recs[i].id + 1);
+        }
+        replayed_ = unfinished(spans, &stats_);
+        for (const auto& l : logs) munmap(l.p, l.bytes);
+    }
+
+    // Creates path, sized for `capacity` records, with an empty log.
+    std::unique_ptr<Segment> open_segment(const std::string& path, std::uint64_t generation,
+                                          std::uint64_t first, std::size_t capacity) const {
+        auto seg = std::make_unique<Segment>();
+        seg->path = path;
+        seg->capacity = capacity;
+        seg->first = first;
+        seg->generation = generation;
+        seg->bytes = kHeaderBytes + capacity * sizeof(Record);
+        seg->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (seg->fd < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+        if (ftruncate(seg->fd, static_cast<off_t>(seg->bytes)) != 0)     // sparse until written
+            throw std::system_error(errno, std::generic_category(), "ftruncate journal");
+        seg->base = mmap(nullptr, seg->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+        if (seg->base == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap journal");
+
+        Header hdr{};
+        std::memcpy(hdr.magic, kMagic, 8);
+        hdr.version = 1;
+        hdr.record_size = sizeof(Record);
+        hdr.capacity = capacity;
+        hdr.generation = generation;
+        std::memcpy(seg->base, &hdr, sizeof(hdr));
+        return seg;
+    }
+
+    // Makes renames and creations in the journal's directory durable.
+    void fsync_dir() const {
+        const auto slash = path_.rfind('/');
+        const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path_.substr(0, slash);
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "open " + dir);
+        int rc = ::fsync(fd);
+        int err = errno;
+        ::close(fd);
+        if (rc != 0) throw std::system_error(err, std::generic_category(), "fsync " + dir);
+    }
+
+    std::size_t capacity_for(std::size_t live) const {
+        return std::max<std::size_t>(opt_.capacity, live * 2 + kHoleWindow);
+    }
+
+    // New file holding only the unfinished Submits, swapped in atomically.
+    void create_compacted() {
+        const std::string tmp = path_ + ".tmp";
+        active_ = open_segment(tmp, generation_ + 1, 0, capacity_for(replayed_.size()));
+        cur_.store(active_.get(), std::memory_order_release);
+        for (const auto& r : replayed_) submit(r.id, r.spec);
+        sync_now();
+        if (::rename(tmp.c_str(), path_.c_str()) != 0)
+            throw std::system_error(errno, std::generic_category(), "rename journal");
+        active_->path = path_;
+        fsync_dir();
+        ::unlink((path_ + ".next").c_str());            // older generation now, if present
+    }
+
+    // ---- online compaction ----
+    // Runs on the flusher once the active segment crosses the high-water
+    // mark. Producers move to path.next as soon as it exists; the records of
+    // the old segment that are still live are then copied into slots reserved
+    // for them at its front, and path.next replaces path. Until that rename,
+    // recovery reads both files.
+    void roll_over() {
+        Segment* old = active_.get();
+        try {
+            // Upper bound on what can still be live in the old segment:
+            // unfinished Submits so far plus every slot not written yet.
+            const std::size_t seen = std::min<std::size_t>(old->tail.load(std::memory_order_relaxed), old->capacity);
+            std::size_t live = unfinished({{old->records(), seen}}, nullptr).size();
+            for (std::size_t i = 0; i < seen; ++i)
+                live += __atomic_load_n(&old->records()[i].check, __ATOMIC_ACQUIRE) == 0;
+            auto next = open_segment(path_ + ".next", old->generation + 1, old->first + old->capacity,
+                                     capacity_for(live + (old->capacity - seen)));
+            fsync_dir();                                // .next may soon hold the only copy of a record
+            retired_.reserve(retired_.size() + 1);
+
+            // Seal the old segment (every later fetch_add lands past its
+            // capacity) and hand producers the new one.
+            const std::size_t end = std::min<std::size_t>(old->tail.exchange(old->capacity), old->capacity);
+            const std::size_t reserved = live + (end - seen);
+            // Recovery must not take the empty reserved prefix for the end of
+            // the log; the header tells it where producers' records begin.
+            static_cast<Header*>(next->base)->reserved = reserved;
+            next->tail.store(reserved, std::memory_order_relaxed);
+            retired_.push_back(std::move(active_));
+            active_ = std::move(next);
+            cur_.store(active_.get(), std::memory_order_release);
+            { std::lock_guard<std::mutex> lk(m_); }
+            roll_cv_.notify_all();
+
+            // Wait for the slots that were reserved before the seal, then
+            // make the old segment durable in full.
+            for (std::size_t i = 0; i < end; ++i)
+                while (__atomic_load_n(&old->records()[i].check, __ATOMIC_ACQUIRE) == 0) std::this_thread::yield();
+            sync_segment(*old, end);
+
+            const auto copies = unfinished({{old->records(), end}}, nullptr);
+            for (std::size_t i = 0; i < reserved; ++i) {
+                if (i < copies.size()) {
+                    const Replayed& r = copies[i];
+                    write(*active_, i, Kind::Submit, r.id, static_cast<std::uint16_t>(r.spec.type), r.spec.a, r.spec.b);
+                } else {
+                    write(*active_, i, Kind::Pad, 0, 0, 0, 0);
+                }
+            }
+            sync_now();
+            if (::rename(active_->path.c_str(), path_.c_str()) != 0)
+                throw std::system_error(errno, std::generic_category(), "rename journal");
+            active_->path = path_;
+            fsync_dir();
+            old->unmap();
+            rollovers_.fetch_add(1, std::memory_order_relaxed);
+        } catch (const std::exception& e) {
+            disable(std::string("rollover failed: ") + e.what());
+        }
+    }
+
+    // ---- group commit ----
+    // Extends seg's durable prefix over every fully written record below
+    // limit and msyncs the pages it covers. Only the flusher (and the
+    // constructor and destructor, while there is no flusher) call this.
+    void sync_segment(Segment& seg, std::uint64_t limit) {
+        std::uint64_t from = seg.synced;
+        std::uint64_t to = from;
+        while (to < limit && __atomic_load_n(&seg.records()[to].check, __ATOMIC_ACQUIRE) != 0) ++to;
+        if (to == from && from != 0) return;
+
+        const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        std::size_t begin = from == 0 ? 0 : kHeaderBytes + from * sizeof(Record);
+        std::size_t end = kHeaderBytes + to * sizeof(Record);
+        begin -= begin % page;
+        msync(static_cast<char*>(seg.base) + begin, end - begin, MS_SYNC);
+        syncs_.fetch_add(1, std::memory_order_relaxed);
+
+        seg.synced = to;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            durable_ = std::max(durable_, seg.first + to);
+        }
+        durable_cv_.notify_all();
+    }
+
+    void sync_now() {
+        Segment& seg = *active_;
+        sync_segment(seg, std::min<std::uint64_t>(seg.tail.load(std::memory_order_acquire), seg.capacity));
+    }
+
+    bool past_high_water() const {
+        const Segment& seg = *active_;
+        return !disabled_.load(std::memory_order_relaxed) &&
+               static_cast<double>(seg.tail.load(std::memory_order_relaxed)) >=
+                   opt_.high_water * static_cast<double>(seg.capacity);
+    }
+
+    void flush_loop() {
+        std::unique_lock<std::mutex> lk(m_);
+        while (!stop_) {
+            flush_cv_.wait_for(lk, opt_.sync_interval, [this]{ return stop_ || durable_waiters_ > 0 || roll_wanted_; });
+            roll_wanted_ = false;
+            lk.unlock();
+            sync_now();
+            if (past_high_water()) roll_over();
+            lk.lock();
+        }
+    }
+
+    std::string path_;
+    Options opt_;
+    std::unique_ptr<Segment> active_;               // flusher-owned
+    std::atomic<Segment*> cur_{nullptr};            // what producers append to
+    std::vector<std::unique_ptr<Segment>> retired_; // unmapped; kept for stale producer pointers
+    std::uint64_t generation_ = 0;
+    std::atomic<std::uint64_t> syncs_{0};
+    std::atomic<std::uint64_t> rollovers_{0};
+    std::atomic<bool> disabled_{false};
+
+    std::vector<Replayed> replayed_;
+    ReplayStats stats_;
+    std::uint64_t next_id_ = 1;
+
+    std::mutex m_;
+    std::condition_variable flush_cv_, durable_cv_, roll_cv_;
+    std::uint64_t durable_ = 0;                     // positions [0, durable_) are on disk
+    std::size_t durable_waiters_ = 0;
+    bool roll_wanted_ = false;
+    bool stop_ = false;
+    std::thread flusher_;
+};
+
+// ---------------- BlockingJobQueue (README Phase 3) + journal ----------------
+class BlockingJobQueue {
+public:
+    BlockingJobQueue() = default;
+
+    // Journaled queue: unfinished jobs from the last run are queued again.
+    explicit BlockingJobQueue(JobJournal* journal) : journal_(journal) {
+        next_id_ = journal_->next_id();
+        for (const auto& r : journal_->replayed()) q_.push({r.id, make_job(r.spec)});
+    }
+
+    void push(std::unique_ptr<Job> job) { push_impl(std::move(job), false); }
+
+    // Returns once the job's Submit record is on disk.
+    void push_durable(std::unique_ptr<Job> job) { push_impl(std::move(job), true); }
+
+    // Blocks until job or shutdown; nullptr once shut down and drained.
+    // *id receives the job's id for done().
+    std::unique_ptr<Job> pop(std::uint64_t* id = nullptr) {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [&]{ return !q_.empty() || stopped_; });
+        if (q_.empty()) return nullptr;
+        Entry e = std::move(q_.front());
+        q_.pop();
+        if (id) *id = e.id;
+        return std::move(e.job);
+    }
+
+    // Worker finished job `id`; it will not be replayed.
+    void done(std::uint64_t id) {
+        if (journal_) journal_->complete(id);
+    }
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stopped_ = true;
+        }
+        cv_.notify_all();
+    }
+
+private:
+    struct Entry {
+        std::uint64_t id;
+        std::unique_ptr<Job> job;
+    };
+
+    void push_impl(std::unique_ptr<Job> job, bool durable) {
+        std::uint64_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+        if (journal_) {
+            // Journal before queueing: a job a worker can see is always on file.
+            std::uint64_t pos = journal_->submit(id, job->spec());
+            if (durable) journal_->wait_durable(pos);
+        }
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            q_.push({id, std::move(job)});
+        }
+        cv_.notify_one();
+    }
+
+    JobJournal* journal_ = nullptr;
+    std::atomic<std::uint64_t> next_id_{1};
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::queue<Entry> q_;
+    bool stopped_ = false;
+};
+
+// ---------------- Demo ----------------
+using clock_type = std::chrono::steady_clock;
+
+double ms_since(clock_type::time_point s) {
+    return std::chrono::duration<double, std::milli>(clock_type::now() - s).count();
+}
+
+std::unique_ptr<Job> demo_job(std::int64_t i) {
+    if (i % 4 == 0) return std::make_unique<PrimeCountJob>(1, 200 + i % 100);
+    return std::make_unique<SumRangeJob>(1, i);
+}
+
+// Producers push `total` jobs between them; returns elapsed ms.
+double produce(BlockingJobQueue& q, int producers, std::int64_t total) {
+    auto s = clock_type::now();
+    std::vector<std::thread> ts;
+    for (int p = 0; p < producers; ++p)
+        ts.emplace_back([&, p]{
+            for (std::int64_t i = p; i < total; i += producers) q.push(demo_job(i));
+        });
+    for (auto& t : ts) t.join();
+    return ms_since(s);
+}
+
+int main() {
+    const std::string path = "code21-journal.bin";
+    const std::int64_t kJobs = 1'000'000;
+    const int kProducers = 4;
+    ::unlink(path.c_str());
+
+    // Producer cost: plain queue vs journaled queue.
+    {
+        BlockingJobQueue plain;
+        double t_plain = produce(plain, kProducers, kJobs);
+        JobJournal j(path + ".bench");
+        BlockingJobQueue journaled(&j);
+        double t_j = produce(journaled, kProducers, kJobs);
+        std::cout << "push " << kJobs << " jobs, " << kProducers << " producers: plain "
+                  << std::fixed << std::setprecision(1) << t_plain << " ms, journaled " << t_j
+                  << " ms\n";
+        auto s = clock_type::now();
+        journaled.push_durable(demo_job(7));
+        std::cout << "push_durable (waits for group commit): " << ms_since(s) << " ms, "
+                  << j.syncs() << " msyncs so far\n";
+    }
+    ::unlink((path + ".bench").c_str());
+
+    // A long-running server: many times more records than one segment holds.
+    {
+        JobJournal::Options opt;
+        opt.capacity = 1u << 16;
+        JobJournal j(path + ".roll", opt);
+        BlockingJobQueue q(&j);
+        std::vector<std::thread> workers;
+        for (int w = 0; w < 2; ++w)
+            workers.emplace_back([&]{
+                std::uint64_t id;
+                while (auto job = q.pop(&id)) {
+                    job->run();
+                    q.done(id);
+                }
+            });
+        double t = produce(q, kProducers, kJobs);
+        q.shutdown();
+        for (auto& w : workers) w.join();
+        struct stat st;
+        ::stat((path + ".roll").c_str(), &st);
+        std::cout << 2 * kJobs << " records through " << opt.capacity << "-record segments: "
+                  << j.rollovers() << " rollovers, " << t << " ms, file " << st.st_size / 1024
+                  << " KB, still journaling: " << (j.journaling() ? "yes" : "no") << "\n";
+    }
+    {
+        JobJournal j(path + ".roll");
+        std::cout << "reopened: " << j.replayed().size() << " unfinished jobs\n";
+    }
+    ::unlink((path + ".roll").c_str());
+
+    // Crash in the middle of a rollover: producers are already writing to
+    // path.next, whose front is still reserved for the copies. Every job the
+    // child journaled and did not finish must be replayed.
+    {
+        struct Counts {
+            std::atomic<std::int64_t> journaled{0}, finished{0};
+        };
+        const std::string roll = path + ".crash";
+        void* shared = mmap(nullptr, sizeof(Counts), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (shared == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap counters");
+        Counts* n = nullptr;
+        bool mid_rollover = false;
+        for (int attempt = 0; attempt < 10 && !mid_rollover; ++attempt) {
+            ::unlink(roll.c_str());
+            ::unlink((roll + ".next").c_str());
+            n = new (shared) Counts;
+            pid_t pid = fork();
+            if (pid == 0) {
+                JobJournal::Options opt;
+                opt.capacity = 1u << 16;
+                JobJournal j(roll, opt);
+                BlockingJobQueue q(&j);
+                std::thread killer([&]{
+                    while (::access((roll + ".next").c_str(), F_OK) != 0) std::this_thread::yield();
+                    const std::int64_t at = n->journaled.load();
+                    while (n->journaled.load() < at + 2000) std::this_thread::yield();
+                    raise(SIGKILL);
+                });
+                std::vector<std::thread> ts;
+                for (int w = 0; w < 2; ++w)
+                    ts.emplace_back([&]{
+                        std::uint64_t id;
+                        while (auto job = q.pop(&id)) {
+                            job->run();
+                            q.done(id);
+                            n->finished.fetch_add(1);
+                        }
+                    });
+                for (int p = 0; p < kProducers; ++p)
+                    ts.emplace_back([&, p]{
+                        for (std::int64_t i = p; ; i += kProducers) {
+                            q.push(demo_job(i));
+                            n->journaled.fetch_add(1);
+                        }
+                    });
+                for (;;) pause();
+            }
+            waitpid(pid, nullptr, 0);
+            mid_rollover = ::access((roll + ".next").c_str(), F_OK) == 0;
+        }
+        JobJournal j(roll);
+        const std::int64_t owed = n->journaled.load() - n->finished.load();
+        std::cout << "killed " << (mid_rollover ? "during" : "outside") << " a rollover with " << owed
+                  << " journaled jobs unfinished: " << j.replayed().size() << " replayed -> "
+                  << (static_cast<std::int64_t>(j.replayed().size()) >= owed ? "none lost" : "JOBS LOST") << "\n";
+        munmap(shared, sizeof(Counts));
+        ::unlink(roll.c_str());
+    }
+
+    // Child: journal 1M jobs, run some, die without warning.
+    pid_t pid = fork();
+    if (pid == 0) {
+        JobJournal j(path);
+        BlockingJobQueue q(&j);
+        std::atomic<std::int64_t> finished{0};
+        std::vector<std::thread> workers;
+        for (int w = 0; w < 2; ++w)
+            workers.emplace_back([&]{
+                std::uint64_t id;
+                while (auto job = q.pop(&id)) {
+                    job->run();
+                    q.done(id);
+                    if (finished.fetch_add(1) + 1 == 300'000) raise(SIGKILL);
+                }
+            });
+        produce(q, kProducers, kJobs);
+        for (;;) pause();
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    std::cout << "child " << (WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL ? "killed (SIGKILL)" : "exited")
+              << " mid-run\n";
+
+    // Parent: recover and finish the rest.
+    JobJournal j(path);
+    const auto& st = j.replay_stats();
+    std::cout << "replay: " << st.submits << " submits, " << st.completes << " completes, "
+              << st.damaged << " damaged -> " << j.replayed().size() << " unfinished jobs re-queued in "
+              << st.ms << " ms\n";
+    BlockingJobQueue q(&j);
+    q.shutdown();
+    std::size_t ran = 0;
+    std::uint64_t id;
+    while (auto job = q.pop(&id)) {
+        job->run();
+        q.done(id);
+        ++ran;
+    }
+    std::cout << "finished " << ran << " replayed jobs; submitted jobs accounted for: "
+              << (st.completes + ran) << "\n";
+    ::unlink(path.c_str());
+}
@@ -0,0 +1,382 @@
+// job_descriptors.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code22-descriptors.cpp -o code22
+//
+// Feeding jobs as std::unique_ptr<Job> costs a heap allocation (plus queue
+// node) and a virtual call per job. Here a job can instead be a plain
+// 32-byte JobDescriptor {type, id, two params}:
+//   - JobRegistry maps type ids to kernels through a flat table; add<T>(id)
+//     registers an existing Job class, run on the stack so the call is direct
+//   - ingest() runs a whole buffer of descriptors on the pool, one task per
+//     chunk of kChunk descriptors, writing into a caller-sized result array:
+//     no allocation per job
+//   - DescriptorFile mmaps a file of descriptors and hands out a pointer to
+//     them, so jobs read from disk are never copied or parsed
+// The descriptor is host-endian and trivially copyable; a producer on the
+// same architecture can write it straight from its own structs.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---------------- Allocation counter (as in code5) ----------------
+static std::atomic<std::size_t> g_allocs{0};
+
+void* operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// ---------------- ThreadPool (as in code1) ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    std::size_t size() const { return workers_.size(); }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.emplace([pkg]{ (*pkg)(); });
+        }
+        cv_.notify_one();
+        return fut;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- Jobs ----------------
+struct JobResult {
+    bool success;
+    std::string message;        // "OK" fits the small-string buffer: no allocation
+    std::int64_t value;
+};
+
+class Job {
+public:
+    virtual ~Job() = default;
+    virtual JobResult run() = 0;
+};
+
+class SumRangeJob : public Job {
+public:
+    SumRangeJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        if (l_ > r_) return {true, "OK", 0};
+        return {true, "OK", (l_ + r_) * (r_ - l_ + 1) / 2};
+    }
+
+private:
+    std::int64_t l_, r_;
+};
+
+class PrimeCountJob : public Job {
+public:
+    PrimeCountJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        std::int64_t n = 0;
+        for (std::int64_t x = std::max<std::int64_t>(l_, 2); x <= r_; ++x) {
+            bool prime = true;
+            for (std::int64_t d = 2; d * d <= x; ++d) if (x % d == 0) { prime = false; break; }
+            n += prime;
+        }
+        return {true, "OK", n};
+    }
+
+private:
+    std::int64_t l_, r_;
+};
+
+// ---------------- Descriptor + registry ----------------
+struct JobDescriptor {
+    std::uint16_t type;
+    std::uint16_t flags;        // reserved, 0
+    std::uint32_t reserved;     // keeps params 8-byte aligned
+    std::uint64_t id;           // caller's correlation id
+    std::int64_t params[2];
+};
+static_assert(sizeof(JobDescriptor) == 32, "descriptor layout is fixed");
+static_assert(std::is_trivially_copyable<JobDescriptor>::value, "descriptor must be memcpy-able");
+
+enum : std::uint16_t { kSumRange = 1, kPrimeCount = 2 };
+
+class JobRegistry {
+public:
+    using Kernel = JobResult (*)(const JobDescriptor&);
+    static constexpr std::size_t kMaxTypes = 256;
+
+    void add(std::uint16_t type, const char* name, Kernel k) {
+        if (type >= kMaxTypes) throw std::out_of_range("job type id too large");
+        table_[type] = {name, k};
+    }
+
+    // Registers a Job class constructible from (param0, param1). The job is
+    // built on the stack and its exact type is known, so run() is a direct call.
+    template<class J>
+    void add(std::uint16_t type, const char* name) {
+        add(type, name, [](const JobDescriptor& d) {
+            J job(d.params[0], d.params[1]);
+            return job.J::run();
+        });
+    }
+
+    JobResult run(const JobDescriptor& d) const {
+        if (d.type >= kMaxTypes || !table_[d.type].kernel)
+            return {false, "Failed: unknown job type", 0};
+        return table_[d.type].kernel(d);
+    }
+
+    const char* name(std::uint16_t type) const {
+        return type < kMaxTypes && table_[type].name ? table_[type].name : "?";
+    }
+
+private:
+    struct Entry {
+        const char* name = nullptr;
+        Kernel kernel = nullptr;
+    };
+    std::array<Entry, kMaxTypes> table_{};
+};
+
+// Runs descs[0..n) on the pool; results[i] belongs to descs[i]. One task and
+// one future per chunk, nothing per job.
+void ingest(ThreadPool& pool, const JobRegistry& reg,
+            const JobDescriptor* descs, std::size_t n, JobResult* results) {
+    constexpr std::size_t kChunk = 4096;
+    std::vector<std::future<void>> futs;
+    futs.reserve((n + kChunk - 1) / kChunk);
+    for (std::size_t begin = 0; begin < n; begin += kChunk) {
+        std::size_t end = std::min(n, begin + kChunk);
+        futs.push_back(pool.submit([&reg, descs, results, begin, end]{
+            for (std::size_t i = begin; i < end; ++i) results[i] = reg.run(descs[i]);
+        }));
+    }
+    for (auto& f : futs) f.get();
+}
+
+// ---------------- Descriptor files ----------------
+// Layout: 16-byte header {magic "JOBDESC1", count}, then count descriptors.
+class DescriptorFile {
+public:
+    static void write(const std::string& path, const std::vector<JobDescriptor>& descs) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+        Header h{};
+        std::memcpy(h.magic, kMagic, 8);
+        h.count = descs.size();
+        bool ok = write_all(fd, &h, sizeof(h)) &&
+                  write_all(fd, descs.data(), descs.size() * sizeof(JobDescriptor));
+        ::close(fd);
+        if (!ok) throw std::runtime_error("short write to " + path);
+    }
+
+    explicit DescriptorFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) { ::close(fd); throw std::system_error(errno, std::generic_category(), "stat " + path); }
+        bytes_ = static_cast<std::size_t>(st.st_size);
+        if (bytes_ < sizeof(Header)) { ::close(fd); throw std::runtime_error("truncated descriptor file"); }
+        map_ = mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map_ == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap " + path);
+        madvise(map_, bytes_, MADV_SEQUENTIAL);
+
+        const auto* h = static_cast<const Header*>(map_);
+        if (std::memcmp(h->magic, kMagic, 8) != 0 ||
+            h->count > (bytes_ - sizeof(Header)) / sizeof(JobDescriptor)) {
+            munmap(map_, bytes_);
+            throw std::runtime_error("bad descriptor file " + path);
+        }
+        count_ = h->count;
+    }
+
+    DescriptorFile(const DescriptorFile&) = delete;
+    DescriptorFile& operator=(const DescriptorFile&) = delete;
+    ~DescriptorFile() { munmap(map_, bytes_); }
+
+    const JobDescriptor* data() const {
+        return reinterpret_cast<const JobDescriptor*>(static_cast<const char*>(map_) + sizeof(Header));
+    }
+    std::size_t size() const { return count_; }
+
+private:
+    struct Header {
+        char magic[8];
+        std::uint64_t count;
+    };
+    static constexpr char kMagic[8] = {'J', 'O', 'B', 'D', 'E', 'S', 'C', '1'};
+
+    static bool write_all(int fd, const void* p, std::size_t n) {
+        const char* c = static_cast<const char*>(p);
+        while (n) {
+            ssize_t w = ::write(fd, c, n);
+            if (w <= 0) return false;
+            c += w;
+            n -= static_cast<std::size_t>(w);
+        }
+        return true;
+    }
+
+    void* map_ = nullptr;
+    std::size_t bytes_ = 0;
+    std::size_t count_ = 0;
+};
+
+// ---------------- Demo / benchmark ----------------
+using clock_type = std::chrono::steady_clock;
+
+struct Run {
+    double ms;
+    std::size_t allocs;
+    std::int64_t checksum;
+};
+
+template<class Fn>
+Run measure(Fn&& fn) {
+    std::size_t a0 = g_allocs.load();
+    auto s = clock_type::now();
+    std::int64_t sum = fn();
+    double ms = std::chrono::duration<double, std::milli>(clock_type::now() - s).count();
+    return {ms, g_allocs.load() - a0, sum};
+}
+
+void report(const char* name, const Run& r, std::size_t jobs) {
+    std::cout << "  " << std::left << std::setw(28) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(8) << r.ms << " ms, "
+              << std::setw(8) << r.allocs << " allocations ("
+              << std::setprecision(3) << static_cast<double>(r.allocs) / jobs << "/job), checksum "
+              << r.checksum << "\n";
+}
+
+int main() {
+    const std::size_t N = 2'000'000;
+    const std::string path = "code22-jobs.bin";
+
+    JobRegistry reg;
+    reg.add<SumRangeJob>(kSumRange, "sum-range");
+    reg.add<PrimeCountJob>(kPrimeCount, "prime-count");
+
+    std::vector<JobDescriptor> descs(N);
+    for (std::size_t i = 0; i < N; ++i) {
+        auto v = static_cast<std::int64_t>(i);
+        descs[i] = i % 8 == 0 ? JobDescriptor{kPrimeCount, 0, 0, i, {1, 50 + v % 50}}
+                              : JobDescriptor{kSumRange, 0, 0, i, {v, v + 1000}};
+    }
+    DescriptorFile::write(path, descs);
+
+    ThreadPool pool(4);
+    std::vector<JobResult> results(N);          // sized once, reused by every run
+    auto checksum = [&]{
+        std::int64_t s = 0;
+        for (const auto& r : results) s += r.value;
+        return s;
+    };
+
+    std::cout << N << " jobs (" << reg.name(kSumRange) << " / " << reg.name(kPrimeCount) << ")\n";
+
+    // Old path: build a Job object per request, queue it, pop it, run it.
+    Run legacy = measure([&]{
+        std::queue<std::unique_ptr<Job>> q;
+        for (const auto& d : descs) {
+            if (d.type == kSumRange) q.push(std::make_unique<SumRangeJob>(d.params[0], d.params[1]));
+            else                     q.push(std::make_unique<PrimeCountJob>(d.params[0], d.params[1]));
+        }
+        std::int64_t s = 0;
+        while (!q.empty()) { s += q.front()->run().value; q.pop(); }
+        return s;
+    });
+    report("unique_ptr<Job> queue (1 thr)", legacy, N);
+
+    Run serial = measure([&]{
+        for (std::size_t i = 0; i < N; ++i) results[i] = reg.run(descs[i]);
+        return checksum();
+    });
+    report("descriptors, serial", serial, N);
+
+    Run buffered = measure([&]{
+        ingest(pool, reg, descs.data(), descs.size(), results.data());
+        return checksum();
+    });
+    report("descriptors, pool ingest", buffered, N);
+
+    Run from_file = measure([&]{
+        DescriptorFile f(path);
+        ingest(pool, reg, f.data(), f.size(), results.data());
+        return checksum();
+    });
+    report("mmap file, pool ingest", from_file, N);
+
+    JobDescriptor bad{99, 0, 0, 7, {0, 0}};
+    std::cout << "unknown type: " << reg.run(bad).message << "\n";
+    ::unlink(path.c_str());
+}
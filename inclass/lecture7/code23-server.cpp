@@ -0,0 +1,767 @@
+// job_server.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code23-server.cpp -o code23
+//
+// README section 8's "web-like API simulation", over a real socket. One epoll
+// thread owns every connection; jobs run on the ThreadPool.
+//
+//   client --[BatchHeader + N x JobDescriptor]--> epoll loop --post--> pool
+//   client <--------- ResultFrame {id, value} ---- epoll loop <--eventfd-- worker
+//
+//   - requests arrive in batches of code22's 32-byte JobDescriptors
+//   - a worker that finishes a job appends its ResultFrame to a completion list
+//     and kicks an eventfd only when the list was empty, so a burst costs one
+//     wakeup; the loop thread does every read, write and close
+//   - results are written as they complete, out of order, tagged with the
+//     descriptor's id
+//   - a connection with kMaxInflight jobs running or kMaxOutBytes unsent is not
+//     read until it drains, so a fast client cannot queue unbounded work
+// The transport is a Unix-domain socket (a path) or loopback TCP ("tcp:PORT").
+// Frames are host-endian: client and server run on the same machine.
+//
+// Usage:
+//   ./code23                                  server + load generator, Unix then TCP
+//   ./code23 server [endpoint] [threads]      serve until Ctrl-C
+//   ./code23 client [endpoint] [conns] [jobs-per-conn]
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ---------------- ThreadPool (as in code1, with post) ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    // Fire-and-forget without a packaged_task/future per job.
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.push(std::move(task));
+        }
+        cv_.notify_one();
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- Jobs + registry (as in code22) ----------------
+struct JobResult {
+    bool success;
+    std::string message;
+    std::int64_t value;
+};
+
+class Job {
+public:
+    virtual ~Job() = default;
+    virtual JobResult run() = 0;
+};
+
+class SumRangeJob : public Job {
+public:
+    SumRangeJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        if (l_ > r_) return {true, "OK", 0};
+        return {true, "OK", (l_ + r_) * (r_ - l_ + 1) / 2};
+    }
+
+private:
+    std::int64_t l_, r_;
+};
+
+class PrimeCountJob : public Job {
+public:
+    PrimeCountJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        std::int64_t n = 0;
+        for (std::int64_t x = std::max<std::int64_t>(l_, 2); x <= r_; ++x) {
+            bool prime = true;
+            for (std::int64_t d = 2; d * d <= x; ++d) if (x % d == 0) { prime = false; break; }
+            n += prime;
+        }
+        return {true, "OK", n};
+    }
+
+private:
+    std::int64_t l_, r_;
+};
+
+struct JobDescriptor {
+    std::uint16_t type;
+    std::uint16_t flags;        // reserved, 0
+    std::uint32_t reserved;     // keeps params 8-byte aligned
+    std::uint64_t id;           // caller's correlation id
+    std::int64_t params[2];
+};
+static_assert(sizeof(JobDescriptor) == 32, "descriptor layout is fixed");
+static_assert(std::is_trivially_copyable<JobDescriptor>::value, "descriptor must be memcpy-able");
+
+enum : std::uint16_t { kSumRange = 1, kPrimeCount = 2 };
+
+class JobRegistry {
+public:
+    using Kernel = JobResult (*)(const JobDescriptor&);
+    static constexpr std::size_t kMaxTypes = 256;
+
+    void add(std::uint16_t type, const char* name, Kernel k) {
+        if (type >= kMaxTypes) throw std::out_of_range("job type id too large");
+        table_[type] = {name, k};
+    }
+
+    template<class J>
+    void add(std::uint16_t type, const char* name) {
+        add(type, name, [](const JobDescriptor& d) {
+            J job(d.params[0], d.params[1]);
+            return job.J::run();
+        });
+    }
+
+    JobResult run(const JobDescriptor& d) const {
+        if (d.type >= kMaxTypes || !table_[d.type].kernel)
+            return {false, "Failed: unknown job type", 0};
+        return table_[d.type].kernel(d);
+    }
+
+private:
+    struct Entry {
+        const char* name = nullptr;
+        Kernel kernel = nullptr;
+    };
+    std::array<Entry, kMaxTypes> table_{};
+};
+
+// ---------------- Wire format ----------------
+constexpr std::uint32_t kBatchMagic = 0x4A4F4242;      // "BBOJ" in memory
+constexpr std::uint32_t kMaxBatch = 4096;
+
+struct BatchHeader {
+    std::uint32_t magic;
+    std::uint32_t count;        // descriptors that follow, 1..kMaxBatch
+};
+
+struct ResultFrame {
+    std::uint64_t id;           // JobDescriptor::id
+    std::int64_t value;
+    std::uint32_t status;       // 0 ok, 1 failed
+    std::uint32_t reserved;
+};
+static_assert(sizeof(BatchHeader) == 8 && sizeof(ResultFrame) == 24, "wire layout is fixed");
+
+// ---------------- Sockets ----------------
+struct Endpoint {
+    std::string unix_path;      // used when port == 0
+    std::uint16_t port = 0;     // 127.0.0.1:port
+
+    static Endpoint parse(const std::string& s) {
+        Endpoint e;
+        if (s.rfind("tcp:", 0) == 0) e.port = static_cast<std::uint16_t>(std::stoi(s.substr(4)));
+        else e.unix_path = s;
+        return e;
+    }
+    std::string str() const { return port ? "tcp:" + std::to_string(port) : unix_path; }
+};
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Listening socket for ep; a TCP port of 0 binds an ephemeral port.
+int listen_on(const Endpoint& ep) {
+    int fd;
+    if (ep.port || ep.unix_path.empty()) {
+        fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw_errno("socket");
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_port = htons(ep.port);
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)) != 0) { ::close(fd); throw_errno("bind tcp"); }
+    } else {
+        fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw_errno("socket");
+        sockaddr_un a{};
+        a.sun_family = AF_UNIX;
+        if (ep.unix_path.size() >= sizeof(a.sun_path)) { ::close(fd); throw std::invalid_argument("socket path too long"); }
+        std::strcpy(a.sun_path, ep.unix_path.c_str());
+        ::unlink(ep.unix_path.c_str());
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)) != 0) { ::close(fd); throw_errno("bind " + ep.unix_path); }
+    }
+    if (::listen(fd, SOMAXCONN) != 0) { ::close(fd); throw_errno("listen"); }
+    return fd;
+}
+
+// Blocking client socket.
+int connect_to(const Endpoint& ep) {
+    int fd;
+    int rc;
+    if (ep.port) {
+        fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw_errno("socket");
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_port = htons(ep.port);
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        rc = ::connect(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a));
+    } else {
+        fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw_errno("socket");
+        sockaddr_un a{};
+        a.sun_family = AF_UNIX;
+        std::strncpy(a.sun_path, ep.unix_path.c_str(), sizeof(a.sun_path) - 1);
+        rc = ::connect(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a));
+    }
+    if (rc != 0) { ::close(fd); throw_errno("connect " + ep.str()); }
+    return fd;
+}
+
+bool write_all(int fd, const void* p, std::size_t n) {
+    const char* c = static_cast<const char*>(p);
+    while (n) {
+        ssize_t w = ::send(fd, c, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        c += w;
+        n -= static_cast<std::size_t>(w);
+    }
+    return true;
+}
+
+// ---------------- JobServer ----------------
+struct ServerStats {
+    std::uint64_t connections;
+    std::uint64_t batches;
+    std::uint64_t jobs;
+    std::uint64_t results;
+    std::uint64_t dropped;      // finished after their connection closed
+};
+
+class JobServer {
+public:
+    static constexpr std::size_t kMaxInflight = 8192;           // jobs per connection
+    static constexpr std::size_t kMaxOutBytes = 1 << 20;        // unsent results per connection
+
+    JobServer(const Endpoint& ep, const JobRegistry& reg, std::size_t threads)
+    : ep_(ep), reg_(reg), pool_(std::make_unique<ThreadPool>(threads)) {
+        listen_fd_ = listen_on(ep);
+        if (ep_.port == 0 && ep_.unix_path.empty()) {
+            sockaddr_in a{};
+            socklen_t len = sizeof(a);
+            getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&a), &len);
+            ep_.port = ntohs(a.sin_port);
+        }
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (wake_fd_ < 0 || epoll_fd_ < 0) throw_errno("eventfd/epoll");
+        watch(listen_fd_, kListenKey, EPOLLIN, EPOLL_CTL_ADD);
+        watch(wake_fd_, kWakeKey, EPOLLIN, EPOLL_CTL_ADD);
+        loop_ = std::thread([this]{ loop(); });
+    }
+
+    JobServer(const JobServer&) = delete;
+    JobServer& operator=(const JobServer&) = delete;
+
+    ~JobServer() {
+        stop();
+        pool_.reset();              // running jobs still post into done_, which is alive
+        for (auto& [id, c] : conns_) ::close(c.fd);
+        ::close(epoll_fd_);
+        ::close(wake_fd_);
+        ::close(listen_fd_);
+        if (!ep_.port) ::unlink(ep_.unix_path.c_str());
+    }
+
+    // Stops the event loop; connections are closed by the destructor.
+    void stop() {
+        if (stopping_.exchange(true)) return;
+        kick();
+        if (loop_.joinable()) loop_.join();
+    }
+
+    const Endpoint& endpoint() const { return ep_; }
+
+    ServerStats stats() const {
+        return {connections_.load(std::memory_order_relaxed), batches_.load(std::memory_order_relaxed),
+                jobs_.load(std::memory_order_relaxed), results_.load(std::memory_order_relaxed),
+                dropped_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    static constexpr std::uint64_t kListenKey = 0, kWakeKey = 1;
+
+    struct Conn {
+        explicit Conn(int f) : fd(f) {}
+
+        int fd;
+        std::vector<char> in;
+        std::size_t in_off = 0;
+        std::vector<char> out;
+        std::size_t out_off = 0;
+        std::size_t inflight = 0;
+        std::uint32_t events = EPOLLIN;
+        bool touched = false;
+    };
+
+    struct Completion {
+        std::uint64_t conn;
+        ResultFrame frame;
+    };
+
+    void watch(int fd, std::uint64_t key, std::uint32_t events, int op) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = key;
+        if (epoll_ctl(epoll_fd_, op, fd, &ev) != 0) throw_errno("epoll_ctl");
+    }
+
+    void kick() {
+        std::uint64_t one = 1;
+        (void)!::write(wake_fd_, &one, sizeof(one));
+    }
+
+    void loop() {
+        epoll_event evs[64];
+        while (!stopping_.load(std::memory_order_acquire)) {
+            int n = epoll_wait(epoll_fd_, evs, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "epoll_wait: " << std::strerror(errno) << "\n";
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                std::uint64_t key = evs[i].data.u64;
+                if (key == kListenKey) accept_all();
+                else if (key == kWakeKey) drain_completions();
+                else on_conn(key, evs[i].events);
+            }
+        }
+    }
+
+    void accept_all() {
+        for (;;) {
+            int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    std::cerr << "accept: " << std::strerror(errno) << "\n";
+                return;
+            }
+            if (ep_.port) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+            std::uint64_t id = next_conn_++;
+            conns_.emplace(id, Conn(fd));
+            watch(fd, id, EPOLLIN, EPOLL_CTL_ADD);
+            connections_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void on_conn(std::uint64_t id, std::uint32_t events) {
+        auto it = conns_.find(id);
+        if (it == conns_.end()) return;
+        Conn& c = it->second;
+        bool ok = !(events & EPOLLERR);
+        if (ok && (events & EPOLLIN)) ok = read_some(c) && parse(id, c);
+        else if (ok && (events & EPOLLHUP)) ok = false;
+        if (ok && (events & EPOLLOUT)) ok = flush(c);
+        if (ok) update_interest(id, c);
+        else close_conn(it);
+    }
+
+    // One read per readiness event; level-triggered epoll calls again if more is queued.
+    bool read_some(Conn& c) {
+        constexpr std::size_t kChunk = 64 * 1024;
+        std::size_t old = c.in.size();
+        c.in.resize(old + kChunk);
+        ssize_t r = ::read(c.fd, c.in.data() + old, kChunk);
+        c.in.resize(old + (r > 0 ? static_cast<std::size_t>(r) : 0));
+        if (r > 0) return true;
+        if (r == 0) return false;                               // peer closed
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+
+    bool accepting(const Conn& c) const {
+        return c.inflight < kMaxInflight && c.out.size() - c.out_off < kMaxOutBytes;
+    }
+
+    // Dispatches every complete batch in c.in; false on a malformed frame.
+    bool parse(std::uint64_t id, Conn& c) {
+        while (accepting(c)) {
+            std::size_t avail = c.in.size() - c.in_off;
+            if (avail < sizeof(BatchHeader)) break;
+            BatchHeader h;
+            std::memcpy(&h, c.in.data() + c.in_off, sizeof(h));
+            if (h.magic != kBatchMagic || h.count == 0 || h.count > kMaxBatch) return false;
+            std::size_t need = sizeof(h) + std::size_t{h.count} * sizeof(JobDescriptor);
+            if (avail < need) break;
+            const char* p = c.in.data() + c.in_off + sizeof(h);
+            for (std::uint32_t k = 0; k < h.count; ++k) {
+                JobDescriptor d;
+                std::memcpy(&d, p + k * sizeof(JobDescriptor), sizeof(d));
+                dispatch(id, d);
+            }
+            c.inflight += h.count;
+            c.in_off += need;
+            batches_.fetch_add(1, std::memory_order_relaxed);
+            jobs_.fetch_add(h.count, std::memory_order_relaxed);
+        }
+        if (c.in_off == c.in.size()) {
+            c.in.clear();
+            c.in_off = 0;
+        } else if (c.in_off >= c.in.size() / 2) {
+            c.in.erase(c.in.begin(), c.in.begin() + static_cast<std::ptrdiff_t>(c.in_off));
+            c.in_off = 0;
+        }
+        return true;
+    }
+
+    void dispatch(std::uint64_t conn, const JobDescriptor& d) {
+        pool_->post([this, conn, d]{
+            JobResult r = reg_.run(d);
+            Completion done{conn, {d.id, r.value, r.success ? 0u : 1u, 0}};
+            bool was_empty;
+            {
+                std::lock_guard<std::mutex> lk(done_m_);
+                was_empty = done_.empty();
+                done_.push_back(done);
+            }
+            if (was_empty) kick();      // the loop has not yet seen this list
+        });
+    }
+
+    void drain_completions() {
+        std::uint64_t ticks;
+        (void)!::read(wake_fd_, &ticks, sizeof(ticks));         // read before the swap
+        {
+            std::lock_guard<std::mutex> lk(done_m_);
+            draining_.swap(done_);
+        }
+        touched_.clear();
+        for (const Completion& d : draining_) {
+            auto it = conns_.find(d.conn);
+            if (it == conns_.end()) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            Conn& c = it->second;
+            const char* f = reinterpret_cast<const char*>(&d.frame);
+            c.out.insert(c.out.end(), f, f + sizeof(ResultFrame));
+            --c.inflight;
+            if (!c.touched) {
+                c.touched = true;
+                touched_.push_back(d.conn);
+            }
+        }
+        results_.fetch_add(draining_.size(), std::memory_order_relaxed);
+        draining_.clear();
+
+        // Write out, then pick up batches that were held back by the limits.
+        for (std::uint64_t id : touched_) {
+            auto it = conns_.find(id);
+            Conn& c = it->second;
+            c.touched = false;
+            if (flush(c) && parse(id, c)) update_interest(id, c);
+            else close_conn(it);
+        }
+    }
+
+    bool flush(Conn& c) {
+        while (c.out_off < c.out.size()) {
+            ssize_t w = ::send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off, MSG_NOSIGNAL);
+            if (w > 0) { c.out_off += static_cast<std::size_t>(w); continue; }
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            return false;
+        }
+        c.out.clear();
+        c.out_off = 0;
+        return true;
+    }
+
+    void update_interest(std::uint64_t id, Conn& c) {
+        std::uint32_t want = (accepting(c) ? EPOLLIN : 0u) | (c.out_off < c.out.size() ? EPOLLOUT : 0u);
+        if (want == c.events) return;
+        watch(c.fd, id, want, EPOLL_CTL_MOD);
+        c.events = want;
+    }
+
+    // Results still running for this connection are counted as dropped.
+    void close_conn(std::unordered_map<std::uint64_t, Conn>::iterator it) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        ::close(it->second.fd);
+        conns_.erase(it);
+    }
+
+    Endpoint ep_;
+    const JobRegistry& reg_;
+    int listen_fd_ = -1, wake_fd_ = -1, epoll_fd_ = -1;
+
+    // Loop thread only.
+    std::unordered_map<std::uint64_t, Conn> conns_;
+    std::uint64_t next_conn_ = 2;
+    std::vector<Completion> draining_;
+    std::vector<std::uint64_t> touched_;
+
+    // Shared with workers.
+    std::mutex done_m_;
+    std::vector<Completion> done_;
+
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::uint64_t> connections_{0}, batches_{0}, jobs_{0}, results_{0}, dropped_{0};
+    std::unique_ptr<ThreadPool> pool_;      // destroyed explicitly, before the fds close
+    std::thread loop_;
+};
+
+// ---------------- Load generator ----------------
+struct LoadConfig {
+    std::size_t connections = 4;
+    std::size_t jobs_per_conn = 200'000;
+    std::size_t batch = 64;
+    std::size_t window = 2048;      // jobs in flight per connection
+};
+
+struct LoadReport {
+    std::size_t jobs;
+    double seconds;
+    double p50_us, p99_us, p999_us, max_us;
+    std::size_t reordered;          // results that arrived after a higher id
+    std::size_t wrong;              // failed, or a sum that does not check out
+};
+
+JobDescriptor make_request(std::uint64_t i) {
+    auto v = static_cast<std::int64_t>(i % 100'000);
+    if (i % 8 == 0) return {kPrimeCount, 0, 0, i, {1, 500 + v % 1500}};
+    return {kSumRange, 0, 0, i, {v, v + 1000}};
+}
+
+// One connection: this thread reads results, a helper thread sends batches
+// while fewer than cfg.window jobs are outstanding. Latency is send to receive.
+void drive_connection(const Endpoint& ep, const LoadConfig& cfg, std::vector<double>& lat,
+                      std::size_t& reordered, std::size_t& wrong) {
+    using clock_type = std::chrono::steady_clock;
+    const std::size_t jobs = cfg.jobs_per_conn;
+    const std::size_t window = std::max(cfg.window, cfg.batch);
+    int fd = connect_to(ep);
+    std::vector<clock_type::time_point> sent(jobs);
+    std::mutex m;
+    std::condition_variable cv;
+    std::size_t outstanding = 0;
+    bool broken = false;
+
+    std::thread writer([&]{
+        std::vector<char> buf(sizeof(BatchHeader) + cfg.batch * sizeof(JobDescriptor));
+        for (std::size_t i = 0; i < jobs;) {
+            auto k = static_cast<std::uint32_t>(std::min(cfg.batch, jobs - i));
+            {
+                std::unique_lock<std::mutex> lk(m);
+                cv.wait(lk, [&]{ return broken || outstanding + k <= window; });
+                if (broken) return;
+                outstanding += k;
+            }
+            BatchHeader h{kBatchMagic, k};
+            std::memcpy(buf.data(), &h, sizeof(h));
+            for (std::uint32_t j = 0; j < k; ++j) {
+                JobDescriptor d = make_request(i + j);
+                std::memcpy(buf.data() + sizeof(h) + j * sizeof(d), &d, sizeof(d));
+            }
+            auto now = clock_type::now();
+            for (std::uint32_t j = 0; j < k; ++j) sent[i + j] = now;
+            if (!write_all(fd, buf.data(), sizeof(h) + k * sizeof(JobDescriptor))) return;
+            i += k;
+        }
+    });
+
+    std::vector<char> in(sizeof(ResultFrame) * 1024);
+    std::size_t have = 0, received = 0;
+    std::uint64_t highest = 0;
+    while (received < jobs) {
+        ssize_t r = ::read(fd, in.data() + have, in.size() - have);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        have += static_cast<std::size_t>(r);
+        auto now = clock_type::now();
+        std::size_t frames = have / sizeof(ResultFrame);
+        for (std::size_t f = 0; f < frames; ++f) {
+            ResultFrame rf;
+            std::memcpy(&rf, in.data() + f * sizeof(rf), sizeof(rf));
+            if (rf.id >= jobs) { ++wrong; continue; }
+            lat.push_back(std::chrono::duration<double, std::micro>(now - sent[rf.id]).count());
+            if (rf.id < highest) ++reordered;
+            highest = std::max(highest, rf.id);
+            JobDescriptor d = make_request(rf.id);
+            std::int64_t l = d.params[0], h = d.params[1];
+            if (rf.status != 0 || (d.type == kSumRange && rf.value != (l + h) * (h - l + 1) / 2)) ++wrong;
+        }
+        std::size_t used = frames * sizeof(ResultFrame);
+        std::memmove(in.data(), in.data() + used, have - used);
+        have -= used;
+        received += frames;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            outstanding -= frames;
+        }
+        cv.notify_one();
+    }
+    if (received < jobs) {
+        std::cerr << "connection lost after " << received << " results\n";
+        std::lock_guard<std::mutex> lk(m);
+        broken = true;
+    }
+    cv.notify_one();
+    ::shutdown(fd, SHUT_RDWR);      // unblocks a writer stuck in send
+    writer.join();
+    ::close(fd);
+}
+
+LoadReport run_load(const Endpoint& ep, const LoadConfig& cfg) {
+    std::vector<std::vector<double>> lat(cfg.connections);
+    std::vector<std::size_t> reordered(cfg.connections, 0), wrong(cfg.connections, 0);
+    for (auto& l : lat) l.reserve(cfg.jobs_per_conn);
+
+    auto s = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (std::size_t c = 0; c < cfg.connections; ++c)
+        clients.emplace_back([&, c]{
+            try { drive_connection(ep, cfg, lat[c], reordered[c], wrong[c]); }
+            catch (const std::exception& e) { std::cerr << "client: " << e.what() << "\n"; }
+        });
+    for (auto& t : clients) t.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - s).count();
+
+    std::vector<double> all;
+    for (auto& l : lat) all.insert(all.end(), l.begin(), l.end());
+    LoadReport rep{all.size(), secs, 0, 0, 0, 0, 0, 0};
+    for (std::size_t c = 0; c < cfg.connections; ++c) {
+        rep.reordered += reordered[c];
+        rep.wrong += wrong[c];
+    }
+    if (all.empty()) return rep;
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all[std::min(all.size() - 1, static_cast<std::size_t>(p * all.size()))]; };
+    rep.p50_us = pct(0.50);
+    rep.p99_us = pct(0.99);
+    rep.p999_us = pct(0.999);
+    rep.max_us = all.back();
+    return rep;
+}
+
+void print(const Endpoint& ep, const LoadConfig& cfg, const LoadReport& r) {
+    std::cout << ep.str() << ": " << cfg.connections << " conns x " << cfg.jobs_per_conn
+              << " jobs, batch " << cfg.batch << ", window " << cfg.window << "\n"
+              << std::fixed << std::setprecision(0)
+              << "  " << r.jobs / r.seconds << " jobs/s, latency p50 " << r.p50_us << " us, p99 "
+              << r.p99_us << " us, p99.9 " << r.p999_us << " us, max " << r.max_us << " us\n"
+              << "  out of order " << r.reordered << ", wrong " << r.wrong << "\n";
+}
+
+// ---------------- main ----------------
+int main(int argc, char** argv) {
+    JobRegistry reg;
+    reg.add<SumRangeJob>(kSumRange, "sum-range");
+    reg.add<PrimeCountJob>(kPrimeCount, "prime-count");
+
+    const std::string mode = argc > 1 ? argv[1] : "";
+    const Endpoint ep = Endpoint::parse(argc > 2 ? argv[2] : "/tmp/code23.sock");
+
+    if (mode == "server") {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGINT);
+        sigaddset(&set, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &set, nullptr);     // before any thread starts
+        JobServer server(ep, reg, argc > 3 ? std::stoul(argv[3]) : 4);
+        std::cout << "serving on " << server.endpoint().str() << "\n";
+        int sig;
+        sigwait(&set, &sig);
+        server.stop();
+        ServerStats s = server.stats();
+        std::cout << "\n" << s.connections << " connections, " << s.batches << " batches, "
+                  << s.jobs << " jobs, " << s.results << " results\n";
+        return 0;
+    }
+    if (mode == "client") {
+        LoadConfig cfg;
+        if (argc > 3) cfg.connections = std::stoul(argv[3]);
+        if (argc > 4) cfg.jobs_per_conn = std::stoul(argv[4]);
+        print(ep, cfg, run_load(ep, cfg));
+        return 0;
+    }
+
+    // Demo: both ends in one process, Unix socket then loopback TCP.
+    LoadConfig cfg;
+    for (const Endpoint& where : {ep, Endpoint::parse("tcp:0")}) {
+        JobServer server(where, reg, 4);
+        print(server.endpoint(), cfg, run_load(server.endpoint(), cfg));
+        server.stop();
+        ServerStats s = server.stats();
+        std::cout << "  server: " << s.connections << " connections, " << s.batches << " batches, "
+                  << s.jobs << " jobs, " << s.results << " results, " << s.dropped << " dropped\n";
+    }
+}
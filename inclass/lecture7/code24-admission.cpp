@@ -0,0 +1,304 @@
+// admission.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code24-admission.cpp -o code24
+//
+// code1's submit() takes everything. Under a spike the queue grows without
+// limit and every job waits behind the backlog. Here each submit goes
+// through admission first, all under the queue lock it takes anyway:
+//   - AdmissionPolicy::max_queue_depth     queued jobs, 0 = unlimited
+//   - AdmissionPolicy::max_queue_wait      estimated wait for a new job:
+//                                          queued * service time / workers,
+//                                          where service time is an EWMA that
+//                                          workers fold in when they pop
+//   - set_rate_limit(tenant, rate, burst)  token bucket per tenant (or per job
+//                                          type, since the key is just a string)
+// The checks run in that order. A token is taken only when the first two
+// pass, so a job rejected for depth does not use up its tenant's budget.
+// try_submit() returns Admit::... without throwing. submit() keeps code1's
+// signature and throws Rejected. stats() counts rejections by reason and by tenant.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+// ---------------- Admission policy ----------------
+struct AdmissionPolicy {
+    std::size_t max_queue_depth = 0;                // 0 = unlimited
+    std::chrono::microseconds max_queue_wait{0};    // 0 = unlimited
+    double service_ewma_alpha = 0.05;               // weight of the newest sample
+    std::chrono::microseconds initial_service{0};   // estimate until a job has finished
+};
+
+enum class Admit { Accepted, QueueFull, WaitTooLong, RateLimited, Stopped };
+
+inline const char* to_string(Admit a) {
+    switch (a) {
+        case Admit::Accepted:    return "accepted";
+        case Admit::QueueFull:   return "queue full";
+        case Admit::WaitTooLong: return "estimated wait too long";
+        case Admit::RateLimited: return "rate limited";
+        case Admit::Stopped:     return "pool stopped";
+    }
+    return "?";
+}
+
+class Rejected : public std::runtime_error {
+public:
+    explicit Rejected(Admit why)
+    : std::runtime_error(std::string("submit rejected: ") + to_string(why)), why(why) {}
+    Admit why;
+};
+
+template<class R>
+struct Admission {
+    Admit status;
+    std::future<R> future;      // valid only when accepted
+    explicit operator bool() const { return status == Admit::Accepted; }
+};
+
+// Classic token bucket; the caller holds the pool lock.
+class TokenBucket {
+public:
+    TokenBucket(double rate, double burst)
+    : rate_(rate), burst_(burst), tokens_(burst), last_(clock_type::now()) {}
+
+    bool take(clock_type::time_point now) {
+        std::chrono::duration<double> dt = now - last_;
+        tokens_ = std::min(burst_, tokens_ + rate_ * dt.count());
+        last_ = now;
+        if (tokens_ < 1.0) return false;
+        tokens_ -= 1.0;
+        return true;
+    }
+
+private:
+    double rate_, burst_, tokens_;
+    clock_type::time_point last_;
+};
+
+struct AdmissionStats {
+    std::uint64_t accepted = 0;
+    std::uint64_t rejected_queue_full = 0;
+    std::uint64_t rejected_wait = 0;
+    std::uint64_t rejected_rate = 0;
+    std::size_t queued = 0;
+    std::size_t peak_queued = 0;
+    double service_us = 0;          // EWMA per job
+    double est_wait_us = 0;         // for a job submitted now
+    std::map<std::string, std::uint64_t> rejected_by_tenant;
+};
+
+// ---------------- ThreadPool with admission control ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency(), AdmissionPolicy policy = {})
+    : policy_(policy), stop_(false), service_us_(static_cast<double>(policy.initial_service.count())) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                double last_us = -1;        // previous job's service time, folded in at the next pop
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        if (last_us >= 0) {
+                            service_us_ = service_us_ == 0 ? last_us
+                                : service_us_ + policy_.service_ewma_alpha * (last_us - service_us_);
+                        }
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    auto s = clock_type::now();
+                    try { task(); } catch (...) { /* swallow/log */ }
+                    last_us = std::chrono::duration<double, std::micro>(clock_type::now() - s).count();
+                }
+            });
+        }
+    }
+
+    // Jobs of this tenant are admitted at most `rate` per second, with bursts
+    // of up to `burst`. Tenants without a limit are only subject to the policy.
+    void set_rate_limit(const std::string& tenant, double rate, double burst) {
+        std::lock_guard<std::mutex> lk(m_);
+        buckets_.insert_or_assign(tenant, TokenBucket(rate, burst));
+    }
+
+    // Fails fast instead of queueing: the future is valid only if accepted.
+    template<class F, class... A>
+    auto try_submit(const std::string& tenant, F&& f, A&&... a)
+      -> Admission<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        Admit why;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            why = admit_locked(tenant);
+            if (why == Admit::Accepted) {
+                q_.emplace([pkg]{ (*pkg)(); });
+                peak_queued_ = std::max(peak_queued_, q_.size());
+            }
+        }
+        if (why != Admit::Accepted) return {why, {}};
+        cv_.notify_one();
+        return {why, pkg->get_future()};
+    }
+
+    // code1's submit for the default tenant; throws Rejected instead of queueing.
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        auto r = try_submit(std::string(), std::forward<F>(f), std::forward<A>(a)...);
+        if (!r) throw Rejected(r.status);
+        return std::move(r.future);
+    }
+
+    AdmissionStats stats() const {
+        std::lock_guard<std::mutex> lk(m_);
+        AdmissionStats s = stats_;
+        s.queued = q_.size();
+        s.peak_queued = peak_queued_;
+        s.service_us = service_us_;
+        s.est_wait_us = est_wait_us_locked();
+        return s;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    double est_wait_us_locked() const {
+        return static_cast<double>(q_.size()) * service_us_ / static_cast<double>(workers_.size());
+    }
+
+    Admit admit_locked(const std::string& tenant) {
+        Admit why = Admit::Accepted;
+        if (stop_) {
+            why = Admit::Stopped;
+        } else if (policy_.max_queue_depth && q_.size() >= policy_.max_queue_depth) {
+            why = Admit::QueueFull;
+            ++stats_.rejected_queue_full;
+        } else if (policy_.max_queue_wait.count() &&
+                   est_wait_us_locked() > static_cast<double>(policy_.max_queue_wait.count())) {
+            why = Admit::WaitTooLong;
+            ++stats_.rejected_wait;
+        } else if (auto it = buckets_.find(tenant);
+                   it != buckets_.end() && !it->second.take(clock_type::now())) {
+            why = Admit::RateLimited;
+            ++stats_.rejected_rate;
+        }
+        if (why == Admit::Accepted) ++stats_.accepted;
+        else if (why != Admit::Stopped) ++stats_.rejected_by_tenant[tenant];
+        return why;
+    }
+
+    AdmissionPolicy policy_;
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+
+    // Guarded by m_.
+    std::unordered_map<std::string, TokenBucket> buckets_;
+    double service_us_;
+    std::size_t peak_queued_ = 0;
+    AdmissionStats stats_;
+};
+
+// ---------------- Demo ----------------
+void spin_for(std::chrono::microseconds d) {
+    auto end = clock_type::now() + d;
+    while (clock_type::now() < end) {}
+}
+
+// A spike of `n` jobs (~100us each) arrives at once; 3 in 4 come from "web",
+// the rest from "batch". Latency is submit to finish, accepted jobs only.
+void spike(const char* name, AdmissionPolicy policy, bool limit_batch, int n = 20000) {
+    ThreadPool pool(4, policy);
+    if (limit_batch) pool.set_rate_limit("batch", 2000, 50);
+
+    auto s = clock_type::now();
+    std::vector<std::future<double>> futs;
+    futs.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        const std::string tenant = i % 4 == 3 ? "batch" : "web";
+        auto submitted = clock_type::now();
+        auto r = pool.try_submit(tenant, [submitted]{
+            spin_for(std::chrono::microseconds(100));
+            return std::chrono::duration<double, std::milli>(clock_type::now() - submitted).count();
+        });
+        if (r) futs.push_back(std::move(r.future));
+        if (i % 500 == 499) std::this_thread::sleep_for(std::chrono::milliseconds(2));   // arrivals keep coming
+    }
+    double submit_ms = std::chrono::duration<double, std::milli>(clock_type::now() - s).count();
+    AdmissionStats at_end = pool.stats();
+
+    std::vector<double> lat;
+    for (auto& f : futs) lat.push_back(f.get());
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p) { return lat.empty() ? 0.0 : lat[std::min(lat.size() - 1, static_cast<std::size_t>(p * lat.size()))]; };
+
+    AdmissionStats st = pool.stats();
+    std::cout << name << "\n" << std::fixed << std::setprecision(1)
+              << "  accepted " << st.accepted << ", rejected: queue " << st.rejected_queue_full
+              << ", wait " << st.rejected_wait << ", rate " << st.rejected_rate << "  (submit loop "
+              << submit_ms << " ms)\n"
+              << "  peak queue " << st.peak_queued << ", service " << st.service_us
+              << " us/job, est. wait at end of spike " << at_end.est_wait_us / 1000 << " ms\n"
+              << "  latency of accepted jobs: p50 " << pct(0.5) << " ms, p99 " << pct(0.99)
+              << " ms, max " << (lat.empty() ? 0.0 : lat.back()) << " ms\n";
+    for (const auto& [tenant, count] : st.rejected_by_tenant)
+        std::cout << "  rejected for " << tenant << ": " << count << "\n";
+}
+
+int main() {
+    spike("unbounded (code1 behaviour)", AdmissionPolicy{}, false);
+    spike("max_queue_depth = 256", AdmissionPolicy{256, {}}, false);
+    spike("max_queue_wait = 5 ms", AdmissionPolicy{0, std::chrono::milliseconds(5), 0.05, std::chrono::microseconds(100)}, false);
+    spike("max_queue_wait = 5 ms, batch limited to 2000/s", AdmissionPolicy{0, std::chrono::milliseconds(5), 0.05, std::chrono::microseconds(100)}, true);
+
+    // submit() throws once the policy says no.
+    ThreadPool pool(1, AdmissionPolicy{1, {}});
+    std::promise<void> gate;
+    auto opened = gate.get_future().share();
+    auto hold = pool.submit([opened]{ opened.wait(); });        // occupies the worker
+    while (pool.stats().queued != 0) std::this_thread::yield();
+    auto queued = pool.submit([]{});                            // fills the one queue slot
+    try {
+        pool.submit([]{});
+    } catch (const Rejected& e) {
+        std::cout << "\nsubmit: " << e.what() << "\n";
+    }
+    gate.set_value();
+    hold.get();
+    queued.get();
+}
@@ -0,0 +1,332 @@
+// task_graph.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code25-dag.cpp -o code25
+//
+// Phase 4's demo waits on futures one by one in main. Here a pipeline is a
+// TaskGraph: each node names the nodes it depends on, and run() lets the pool
+// drive it.
+//   - add(name, fn, deps) only accepts existing nodes as deps, so a graph is
+//     acyclic by construction
+//   - each node has an atomic pending-inputs counter; the predecessor whose
+//     fetch_sub takes it to zero posts the node, so there are no locks
+//   - the graph is built once and run many times; counters are reset per run
+//   - a node that throws poisons its successors, and they poison theirs, so
+//     everything downstream of the failure is skipped while independent
+//     branches still run; run() rethrows the first exception once the graph
+//     has drained
+//   - run() returns a RunReport: per-node ready/start/end times, and the
+//     critical path, found by following "which input finished last" back from
+//     the node that ended last
+// Nodes pass data through whatever they capture. The graph owns no values.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+// ---------------- ThreadPool (as in code1, with post) ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.push(std::move(task));
+        }
+        cv_.notify_one();
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- TaskGraph ----------------
+using NodeId = std::size_t;
+constexpr NodeId kNoNode = static_cast<NodeId>(-1);
+
+struct NodeTiming {
+    double ready_us;            // all inputs done (run start for roots)
+    double start_us;
+    double end_us;
+    NodeId enabled_by;          // input that finished last; kNoNode for roots
+    bool ran;                   // false if it failed, or an upstream node did
+};
+
+struct RunReport {
+    double wall_us = 0;
+    double work_us = 0;                 // sum of node run times
+    std::vector<NodeTiming> nodes;
+    std::vector<NodeId> critical_path;  // first to last
+};
+
+class TaskGraph {
+public:
+    NodeId add(std::string name, std::function<void()> fn, const std::vector<NodeId>& deps = {}) {
+        const NodeId id = nodes_.size();
+        for (NodeId d : deps) {
+            if (d >= id) throw std::invalid_argument("dependency on a node that does not exist yet");
+            nodes_[d].succs.push_back(id);
+        }
+        nodes_.push_back({std::move(name), std::move(fn), static_cast<int>(deps.size()), {}});
+        return id;
+    }
+
+    std::size_t size() const { return nodes_.size(); }
+    const std::string& name(NodeId n) const { return nodes_[n].name; }
+
+    // Runs every node once, each as soon as its inputs are done, and blocks
+    // until the whole graph has finished. One run at a time per graph.
+    RunReport run(ThreadPool& pool) {
+        if (running_.exchange(true)) throw std::logic_error("TaskGraph::run while already running");
+        const std::size_t n = nodes_.size();
+        if (!state_ || state_size_ != n) {
+            state_ = std::make_unique<NodeState[]>(n);
+            state_size_ = n;
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            state_[i].pending.store(nodes_[i].in_degree, std::memory_order_relaxed);
+            state_[i].poisoned.store(false, std::memory_order_relaxed);
+            state_[i].timing = {0, 0, 0, kNoNode, false};
+        }
+        remaining_.store(n, std::memory_order_relaxed);
+        error_ = nullptr;
+        done_ = n == 0;
+        start_ = clock_type::now();
+
+        for (NodeId i = 0; i < n; ++i)
+            if (nodes_[i].in_degree == 0) schedule(pool, i, kNoNode);
+        {
+            std::unique_lock<std::mutex> lk(done_m_);
+            done_cv_.wait(lk, [this]{ return done_; });
+        }
+
+        RunReport rep;
+        rep.wall_us = us_since_start(clock_type::now());
+        rep.nodes.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            const NodeTiming& t = state_[i].timing;
+            rep.nodes.push_back(t);
+            if (t.ran) rep.work_us += t.end_us - t.start_us;
+        }
+        NodeId last = kNoNode;
+        for (NodeId i = 0; i < n; ++i)
+            if (last == kNoNode || rep.nodes[i].end_us > rep.nodes[last].end_us) last = i;
+        for (NodeId i = last; i != kNoNode; i = rep.nodes[i].enabled_by) rep.critical_path.push_back(i);
+        std::reverse(rep.critical_path.begin(), rep.critical_path.end());
+
+        std::exception_ptr err = error_;
+        running_.store(false);
+        if (err) std::rethrow_exception(err);
+        return rep;
+    }
+
+    void print(const RunReport& r, std::ostream& os = std::cout) const {
+        double path_run = 0, path_wait = 0;
+        for (NodeId i : r.critical_path) {
+            path_run += r.nodes[i].end_us - r.nodes[i].start_us;
+            path_wait += r.nodes[i].start_us - r.nodes[i].ready_us;
+        }
+        os << std::fixed << std::setprecision(2)
+           << "  wall " << r.wall_us / 1000 << " ms, work " << r.work_us / 1000 << " ms, parallelism "
+           << (r.wall_us > 0 ? r.work_us / r.wall_us : 0) << "x\n"
+           << "  critical path: " << path_run / 1000 << " ms running + " << path_wait / 1000
+           << " ms queued\n";
+        for (NodeId i : r.critical_path) {
+            const NodeTiming& t = r.nodes[i];
+            os << "    " << std::left << std::setw(18) << nodes_[i].name << std::right
+               << " ready " << std::setw(7) << t.ready_us / 1000
+               << "  start " << std::setw(7) << t.start_us / 1000
+               << "  end " << std::setw(7) << t.end_us / 1000 << " ms\n";
+        }
+    }
+
+private:
+    struct Node {
+        std::string name;
+        std::function<void()> fn;
+        int in_degree;
+        std::vector<NodeId> succs;
+    };
+
+    struct NodeState {
+        std::atomic<int> pending{0};
+        std::atomic<bool> poisoned{false};  // an input failed or was skipped
+        NodeTiming timing{};        // written only by the worker that runs the node
+    };
+
+    double us_since_start(clock_type::time_point t) const {
+        return std::chrono::duration<double, std::micro>(t - start_).count();
+    }
+
+    void schedule(ThreadPool& pool, NodeId id, NodeId enabled_by) {
+        NodeTiming& t = state_[id].timing;
+        t.enabled_by = enabled_by;
+        t.ready_us = us_since_start(clock_type::now());
+        pool.post([this, &pool, id]{ execute(pool, id); });
+    }
+
+    void execute(ThreadPool& pool, NodeId id) {
+        NodeTiming& t = state_[id].timing;
+        t.start_us = us_since_start(clock_type::now());
+        bool ok = false;
+        if (!state_[id].poisoned.load(std::memory_order_relaxed)) {
+            try {
+                nodes_[id].fn();
+                t.ran = ok = true;
+            } catch (...) {
+                std::lock_guard<std::mutex> lk(done_m_);
+                if (!error_) error_ = std::current_exception();
+            }
+        }
+        t.end_us = us_since_start(clock_type::now());
+
+        // Whoever brings a successor's count to zero owns scheduling it; the
+        // acq_rel decrement carries the poison mark along with it.
+        for (NodeId s : nodes_[id].succs) {
+            if (!ok) state_[s].poisoned.store(true, std::memory_order_relaxed);
+            if (state_[s].pending.fetch_sub(1, std::memory_order_acq_rel) == 1) schedule(pool, s, id);
+        }
+
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lk(done_m_);
+            done_ = true;
+            done_cv_.notify_all();
+        }
+    }
+
+    std::vector<Node> nodes_;
+
+    // Per-run state, reused across runs.
+    std::unique_ptr<NodeState[]> state_;
+    std::size_t state_size_ = 0;
+    std::atomic<std::size_t> remaining_{0};
+    std::exception_ptr error_;          // first failure; guarded by done_m_
+    clock_type::time_point start_;
+    std::atomic<bool> running_{false};
+    std::mutex done_m_;
+    std::condition_variable done_cv_;
+    bool done_ = false;
+};
+
+// ---------------- Demo: count primes in 8 ranges, combine, verify ----------------
+std::int64_t count_primes(std::int64_t lo, std::int64_t hi) {      // [lo, hi)
+    std::int64_t n = 0;
+    for (std::int64_t x = std::max<std::int64_t>(lo, 2); x < hi; ++x) {
+        bool prime = true;
+        for (std::int64_t d = 2; d * d <= x; ++d) if (x % d == 0) { prime = false; break; }
+        n += prime;
+    }
+    return n;
+}
+
+std::int64_t sieve_count(std::int64_t hi) {                       // [0, hi)
+    std::vector<char> composite(static_cast<std::size_t>(hi), 0);
+    std::int64_t n = 0;
+    for (std::int64_t i = 2; i < hi; ++i) {
+        if (composite[i]) continue;
+        ++n;
+        for (std::int64_t j = i * i; j < hi; j += i) composite[j] = 1;
+    }
+    return n;
+}
+
+int main() {
+    ThreadPool pool(4);
+    const std::int64_t N = 400'000;
+    const int K = 8;
+
+    // Deliberately uneven ranges: later ones have more numbers and bigger divisors.
+    std::vector<std::int64_t> bounds{0};
+    for (int k = 1; k <= K; ++k) bounds.push_back(static_cast<std::int64_t>(N * std::pow(k / double(K), 0.7)));
+    bounds.back() = N;
+
+    std::vector<std::int64_t> parts(K);
+    std::int64_t total = 0, reference = 0;
+    bool verified = false;
+
+    TaskGraph g;
+    std::vector<NodeId> counts;
+    for (int k = 0; k < K; ++k) {
+        std::int64_t lo = bounds[k], hi = bounds[k + 1];
+        counts.push_back(g.add("primes[" + std::to_string(k) + "]",
+                               [&parts, k, lo, hi]{ parts[k] = count_primes(lo, hi); }));
+    }
+    NodeId combine = g.add("combine", [&]{
+        total = 0;
+        for (auto p : parts) total += p;
+    }, counts);
+    NodeId sieve = g.add("reference sieve", [&]{ reference = sieve_count(N); });
+    g.add("verify", [&]{
+        verified = total == reference;
+        if (!verified) throw std::runtime_error("prime counts disagree");
+    }, {combine, sieve});
+
+    for (int run = 1; run <= 3; ++run) {
+        RunReport r = g.run(pool);
+        std::cout << "run " << run << ": " << total << " primes below " << N
+                  << (verified ? " (verified)" : " (NOT verified)") << "\n";
+        if (run == 3) g.print(r);
+    }
+
+    // A failing node skips its dependents; independent nodes still run, and
+    // run() rethrows.
+    TaskGraph bad;
+    NodeId a = bad.add("load", []{ throw std::runtime_error("load failed"); });
+    NodeId b = bad.add("side", []{ std::cout << "\nside ran\n"; });
+    bad.add("use", []{ std::cout << "never printed\n"; }, {a, b});
+    bad.add("report", []{ std::cout << "report ran\n"; }, {b});
+    try {
+        bad.run(pool);
+    } catch (const std::exception& e) {
+        std::cout << "failing graph: " << e.what() << "\n";
+    }
+}
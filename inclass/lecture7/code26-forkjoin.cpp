@@ -0,0 +1,458 @@
+// fork_join.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code26-forkjoin.cpp -o code26
+//
+// A PrimeCountJob over [1, 3M] is one task, so one worker runs it while the
+// rest sit idle. Here jobs can implement SplittableJob:
+//   - size()      work units left (numbers in the range)
+//   - split()     keeps the first half, returns the second as a new job
+//   - combine()   merges two halves' results (default: add values)
+// ForkJoin runs a job on code3's WorkStealingPool, Cilk style:
+//     solve(job): if small enough -> job.run()
+//                 else right = job.split(); push right on my deque;
+//                      solve(job); join(right); combine
+//   - the right half sits on the worker's own deque, so an idle worker can
+//     steal it; if nobody does, join() pops it back and runs it inline
+//   - a join whose child was stolen does not block: the worker keeps running
+//     other tasks (its own deque, then stealing) until the child is done
+//   - grain is adaptive per root job: leaves time themselves and keep an
+//     estimate of ns per unit, and the grain is sized so a leaf takes about
+//     target_leaf. It is capped at size / (workers * slack), so there are
+//     always enough pieces to balance, and floored at min_grain.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <time.h>
+
+// ---------------- WorkStealingPool (as in code3, plus helping) ----------------
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(std::size_t n = std::thread::hardware_concurrency()) {
+        if (!n) n = 1;
+        queues_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            queues_.push_back(std::make_unique<WorkQueue>());
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            workers_.emplace_back([this, i]{ worker_loop(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        if (stop_.load(std::memory_order_acquire))
+            throw std::runtime_error("submit on stopped pool");
+        push([pkg]{ (*pkg)(); });
+        return fut;
+    }
+
+    // Pushes onto the calling worker's deque (round-robin from outside).
+    void push(std::function<void()> task) {
+        std::size_t idx;
+        if (tls_pool_ == this) {
+            idx = tls_index_;
+        } else {
+            idx = next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        }
+        {
+            std::lock_guard<std::mutex> lk(queues_[idx]->m);
+            queues_[idx]->dq.push_back(std::move(task));
+        }
+        pending_.fetch_add(1);
+        if (sleepers_.load() == 0) return;              // see worker_loop
+        { std::lock_guard<std::mutex> lk(idle_m_); }
+        idle_cv_.notify_one();
+    }
+
+    // Runs one queued task, if there is one: the caller's own deque first
+    // (newest), then a steal. Used by joins so that waiting is never idle.
+    bool run_one() {
+        const bool worker = tls_pool_ == this;
+        const std::size_t i = worker ? tls_index_ : queues_.size();
+        std::function<void()> task;
+        if (!(worker && pop_local(i, task)) && !steal(i, task)) return false;
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        try { task(); } catch (...) { /* swallow/log */ }
+        return true;
+    }
+
+    std::size_t size() const { return workers_.size(); }
+
+    // Index of the calling worker, or size() for threads outside the pool.
+    std::size_t current_worker() const { return tls_pool_ == this ? tls_index_ : workers_.size(); }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lk(idle_m_);
+            stop_.store(true, std::memory_order_release);
+        }
+        idle_cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex m;
+        std::deque<std::function<void()>> dq;
+    };
+
+    bool pop_local(std::size_t i, std::function<void()>& out) {
+        WorkQueue& wq = *queues_[i];
+        std::lock_guard<std::mutex> lk(wq.m);
+        if (wq.dq.empty()) return false;
+        out = std::move(wq.dq.back());
+        wq.dq.pop_back();
+        return true;
+    }
+
+    // thief == size() means "not a worker": every deque is a victim.
+    bool steal(std::size_t thief, std::function<void()>& out) {
+        const std::size_t n = queues_.size();
+        for (std::size_t k = 1; k <= n; ++k) {
+            const std::size_t v = (thief + k) % n;
+            if (v == thief) continue;
+            WorkQueue& wq = *queues_[v];
+            std::unique_lock<std::mutex> lk(wq.m, std::try_to_lock);
+            if (!lk.owns_lock() || wq.dq.empty()) continue;
+            out = std::move(wq.dq.front());
+            wq.dq.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void worker_loop(std::size_t i) {
+        tls_pool_ = this;
+        tls_index_ = i;
+        for (;;) {
+            if (run_one()) continue;
+            // Registered as a sleeper before re-checking pending_: a push
+            // either sees us and notifies, or we see its task.
+            std::unique_lock<std::mutex> lk(idle_m_);
+            sleepers_.fetch_add(1);
+            idle_cv_.wait(lk, [this]{
+                return stop_.load(std::memory_order_relaxed) || pending_.load() > 0;
+            });
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+            if (stop_.load(std::memory_order_relaxed) &&
+                pending_.load(std::memory_order_acquire) == 0) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> next_{0};
+    std::atomic<std::size_t> pending_{0};
+    std::atomic<std::size_t> sleepers_{0};  // workers in (or entering) idle_cv_.wait
+    std::atomic<bool> stop_{false};
+    std::mutex idle_m_;
+    std::condition_variable idle_cv_;
+
+    inline static thread_local WorkStealingPool* tls_pool_ = nullptr;
+    inline static thread_local std::size_t tls_index_ = 0;
+};
+
+// ---------------- Jobs ----------------
+struct JobResult {
+    bool success;
+    std::string message;
+    std::int64_t value;
+};
+
+class Job {
+public:
+    virtual ~Job() = default;
+    virtual JobResult run() = 0;
+};
+
+class SplittableJob : public Job {
+public:
+    virtual std::int64_t size() const = 0;
+    virtual std::unique_ptr<SplittableJob> split() = 0;
+    virtual JobResult combine(const JobResult& a, const JobResult& b) const {
+        return {a.success && b.success, "OK", a.value + b.value};
+    }
+};
+
+// README's SumRangeJob as the loop it describes, so it has real cost to split.
+class SumRangeJob : public SplittableJob {
+public:
+    SumRangeJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        std::int64_t s = 0;
+        for (std::int64_t i = l_; i <= r_; ++i) s += i;
+        return {true, "OK", s};
+    }
+    std::int64_t size() const override { return std::max<std::int64_t>(0, r_ - l_ + 1); }
+    std::unique_ptr<SplittableJob> split() override {
+        std::int64_t mid = l_ + (r_ - l_) / 2;
+        auto right = std::make_unique<SumRangeJob>(mid + 1, r_);
+        r_ = mid;
+        return right;
+    }
+
+private:
+    std::int64_t l_, r_;
+};
+
+class PrimeCountJob : public SplittableJob {
+public:
+    PrimeCountJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        std::int64_t n = 0;
+        for (std::int64_t x = std::max<std::int64_t>(l_, 2); x <= r_; ++x) {
+            bool prime = true;
+            for (std::int64_t d = 2; d * d <= x; ++d) if (x % d == 0) { prime = false; break; }
+            n += prime;
+        }
+        return {true, "OK", n};
+    }
+    std::int64_t size() const override { return std::max<std::int64_t>(0, r_ - l_ + 1); }
+    std::unique_ptr<SplittableJob> split() override {
+        std::int64_t mid = l_ + (r_ - l_) / 2;
+        auto right = std::make_unique<PrimeCountJob>(mid + 1, r_);
+        r_ = mid;
+        return right;
+    }
+
+private:
+    std::int64_t l_, r_;
+};
+
+// ---------------- ForkJoin ----------------
+struct ForkJoinConfig {
+    std::int64_t min_grain = 256;                       // never split below this many units
+    std::chrono::microseconds target_leaf{200};         // aim for leaves about this long
+    std::size_t slack = 8;                              // at least workers * slack leaves per root
+    bool split = true;                                  // false: run each job whole (baseline)
+};
+
+struct ForkJoinStats {
+    std::uint64_t leaves = 0;
+    std::uint64_t splits = 0;
+    std::uint64_t joins_inline = 0;     // child was still on our deque
+    std::uint64_t joins_stolen = 0;     // child ran elsewhere; we helped meanwhile
+    std::uint64_t helped = 0;           // tasks run while waiting on a stolen child
+    std::vector<double> worker_cpu_ms;  // CPU time inside leaves, per worker
+};
+
+class ForkJoin {
+public:
+    explicit ForkJoin(WorkStealingPool& pool, ForkJoinConfig cfg = {})
+    : pool_(pool), cfg_(cfg), workers_(pool.size()) {}
+
+    std::future<JobResult> submit(std::unique_ptr<SplittableJob> job) {
+        auto root = std::make_shared<Root>();
+        root->max_grain = std::max<std::int64_t>(
+            cfg_.min_grain, job->size() / static_cast<std::int64_t>(pool_.size() * std::max<std::size_t>(cfg_.slack, 1)));
+        std::shared_ptr<SplittableJob> owned(std::move(job));
+        return pool_.submit([this, root, owned]{ return solve(*root, *owned); });
+    }
+
+    JobResult run(std::unique_ptr<SplittableJob> job) { return submit(std::move(job)).get(); }
+
+    ForkJoinStats stats() const {
+        ForkJoinStats s;
+        s.leaves = leaves_.load(std::memory_order_relaxed);
+        s.splits = splits_.load(std::memory_order_relaxed);
+        s.joins_inline = joins_inline_.load(std::memory_order_relaxed);
+        s.joins_stolen = joins_stolen_.load(std::memory_order_relaxed);
+        s.helped = helped_.load(std::memory_order_relaxed);
+        for (const auto& w : workers_) s.worker_cpu_ms.push_back(w.cpu_ns.load(std::memory_order_relaxed) / 1e6);
+        return s;
+    }
+
+    void reset_stats() {
+        leaves_ = splits_ = joins_inline_ = joins_stolen_ = helped_ = 0;
+        for (auto& w : workers_) w.cpu_ns = 0;
+    }
+
+private:
+    // Shared by every piece of one submitted job.
+    struct Root {
+        std::int64_t max_grain;
+        std::atomic<double> ns_per_unit{0};     // 0 until the first leaf reports
+    };
+
+    // Lives on the parent's stack until join() returns.
+    struct Child {
+        std::unique_ptr<SplittableJob> job;
+        JobResult result;
+        std::exception_ptr error;
+        std::size_t ran_on = 0;                 // worker that ran it
+        std::atomic<bool> done{false};
+    };
+
+    struct alignas(64) WorkerCpu {
+        std::atomic<std::int64_t> cpu_ns{0};
+    };
+
+    static std::int64_t thread_cpu_ns() {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<std::int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+
+    std::int64_t grain(const Root& root) const {
+        double ns = root.ns_per_unit.load(std::memory_order_relaxed);
+        if (ns <= 0) return root.max_grain;
+        auto g = static_cast<std::int64_t>(std::chrono::nanoseconds(cfg_.target_leaf).count() / ns);
+        return std::clamp(g, cfg_.min_grain, root.max_grain);
+    }
+
+    JobResult solve(Root& root, SplittableJob& job) {
+        if (!cfg_.split || job.size() <= grain(root)) return leaf(root, job);
+
+        splits_.fetch_add(1, std::memory_order_relaxed);
+        Child child;
+        child.job = job.split();
+        pool_.push([this, &root, c = &child]{
+            c->ran_on = pool_.current_worker();
+            try { c->result = solve(root, *c->job); }
+            catch (...) { c->error = std::current_exception(); }
+            c->done.store(true, std::memory_order_release);
+        });
+
+        JobResult left;
+        std::exception_ptr left_error;
+        try { left = solve(root, job); }
+        catch (...) { left_error = std::current_exception(); }
+
+        join(child);        // always, even on error: child refers to this frame
+        if (left_error) std::rethrow_exception(left_error);
+        if (child.error) std::rethrow_exception(child.error);
+        return job.combine(left, child.result);
+    }
+
+    // Everything pushed inside solve(left) has been joined by now, so if the
+    // child was not stolen it is the newest task on our deque and run_one()
+    // picks it first.
+    void join(Child& c) {
+        std::uint64_t ran = 0;
+        while (!c.done.load(std::memory_order_acquire)) {
+            if (pool_.run_one()) ++ran;
+            else std::this_thread::yield();     // child is running on another worker
+        }
+        const bool inline_ = c.ran_on == pool_.current_worker();
+        (inline_ ? joins_inline_ : joins_stolen_).fetch_add(1, std::memory_order_relaxed);
+        helped_.fetch_add(ran - (inline_ ? 1 : 0), std::memory_order_relaxed);
+    }
+
+    JobResult leaf(Root& root, SplittableJob& job) {
+        const std::int64_t units = job.size();
+        const std::int64_t c0 = thread_cpu_ns();
+        JobResult r = job.run();
+        const std::int64_t spent = thread_cpu_ns() - c0;
+
+        leaves_.fetch_add(1, std::memory_order_relaxed);
+        std::size_t w = pool_.current_worker();
+        if (w < workers_.size()) workers_[w].cpu_ns.fetch_add(spent, std::memory_order_relaxed);
+        if (units > 0) {
+            double sample = static_cast<double>(spent) / static_cast<double>(units);
+            double old = root.ns_per_unit.load(std::memory_order_relaxed);
+            root.ns_per_unit.store(old == 0 ? sample : old + 0.25 * (sample - old), std::memory_order_relaxed);
+        }
+        return r;
+    }
+
+    WorkStealingPool& pool_;
+    ForkJoinConfig cfg_;
+    std::vector<WorkerCpu> workers_;
+    std::atomic<std::uint64_t> leaves_{0}, splits_{0}, joins_inline_{0}, joins_stolen_{0}, helped_{0};
+};
+
+// ---------------- Demo ----------------
+// Fails in whichever leaf ends up holding 77777.
+class FlakyJob : public SplittableJob {
+public:
+    FlakyJob(std::int64_t l, std::int64_t r) : l_(l), r_(r) {}
+    JobResult run() override {
+        if (l_ <= 77777 && 77777 <= r_) throw std::runtime_error("leaf [" + std::to_string(l_) + ", " + std::to_string(r_) + "] failed");
+        return {true, "OK", r_ - l_ + 1};
+    }
+    std::int64_t size() const override { return std::max<std::int64_t>(0, r_ - l_ + 1); }
+    std::unique_ptr<SplittableJob> split() override {
+        std::int64_t mid = l_ + (r_ - l_) / 2;
+        auto right = std::make_unique<FlakyJob>(mid + 1, r_);
+        r_ = mid;
+        return right;
+    }
+
+private:
+    std::int64_t l_, r_;
+};
+
+using clock_type = std::chrono::steady_clock;
+
+std::unique_ptr<SplittableJob> make(int i) {
+    switch (i) {
+        case 0:  return std::make_unique<PrimeCountJob>(1, 3'000'000);
+        case 1:  return std::make_unique<PrimeCountJob>(1, 100'000);
+        case 2:  return std::make_unique<SumRangeJob>(1, 400'000'000);
+        case 3:  return std::make_unique<PrimeCountJob>(2'000'000, 2'200'000);
+        default: return std::make_unique<SumRangeJob>(1, 1'000);
+    }
+}
+
+void run(const char* name, WorkStealingPool& pool, ForkJoinConfig cfg) {
+    ForkJoin fj(pool, cfg);
+    auto s = clock_type::now();
+    std::vector<std::future<JobResult>> futs;
+    for (int i = 0; i < 5; ++i) futs.push_back(fj.submit(make(i)));
+    std::vector<std::int64_t> values;
+    for (auto& f : futs) values.push_back(f.get().value);
+    double ms = std::chrono::duration<double, std::milli>(clock_type::now() - s).count();
+
+    ForkJoinStats st = fj.stats();
+    double total = 0, most = 0;
+    for (double c : st.worker_cpu_ms) { total += c; most = std::max(most, c); }
+    const double mean = total / static_cast<double>(st.worker_cpu_ms.size());
+
+    std::cout << name << ": " << std::fixed << std::setprecision(1) << ms << " ms, results";
+    for (auto v : values) std::cout << " " << v;
+    std::cout << "\n  leaves " << st.leaves << ", splits " << st.splits << ", joins inline "
+              << st.joins_inline << ", stolen " << st.joins_stolen << ", tasks run while waiting "
+              << st.helped << "\n  CPU per worker (ms):";
+    for (double c : st.worker_cpu_ms) std::cout << " " << c;
+    std::cout << std::setprecision(2) << "   busiest/mean = " << (mean > 0 ? most / mean : 0) << "\n";
+}
+
+int main() {
+    WorkStealingPool pool(4);
+    ForkJoinConfig whole;
+    whole.split = false;
+    run("whole jobs (one task each)", pool, whole);
+    run("fork-join, adaptive grain", pool, ForkJoinConfig{});
+
+    // Exceptions from any leaf reach the caller after the tree has unwound.
+    ForkJoin fj(pool);
+    try {
+        fj.run(std::make_unique<FlakyJob>(1, 100'000));
+    } catch (const std::exception& e) {
+        std::cout << "\nfailing job: " << e.what() << "\n";
+    }
+}
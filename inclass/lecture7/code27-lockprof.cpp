@@ -0,0 +1,418 @@
+// lock_profiler.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread -DLOCK_PROFILE -rdynamic code27-lockprof.cpp -o code27   (profiled)
+//   g++ -std=c++17 -O2 -pthread code27-lockprof.cpp -o code27                            (plain)
+//
+// Is TSQueue::m_ or the pool's m_ a convoy? lockprof::ProfiledMutex answers it.
+//   - it is a Lockable (lock/try_lock/unlock), so TSQueue<T, Mutex> and
+//     ThreadPool<Mutex> take it as a template parameter; std::lock_guard and
+//     std::unique_lock work unchanged, and condition variables switch to
+//     condition_variable_any (cv_for<Mutex>)
+//   - every acquire records wait time and whether it was contended (try_lock
+//     failed first); every unlock records how long the lock was held
+//   - stats are kept per lock name and per call site. A call site is the
+//     return address of lock(), which at -O2 lands in the function that
+//     built the lock_guard (the same trick as mutrace). report() resolves it
+//     with dladdr, so build with -rdynamic to get names.
+//   - without -DLOCK_PROFILE, ProfiledMutex *is* std::mutex and name() is an
+//     empty inline, so profiled code costs nothing in a normal build
+// report() ranks locks and call sites by total wait time.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef LOCK_PROFILE
+#include <cxxabi.h>
+#include <dlfcn.h>
+#endif
+
+// ---------------- lockprof ----------------
+namespace lockprof {
+
+inline void name(std::mutex&, const char*) {}      // plain mutexes have no name
+
+#ifdef LOCK_PROFILE
+
+struct Stats {
+    std::atomic<std::uint64_t> acquires{0};
+    std::atomic<std::uint64_t> contended{0};       // had to wait
+    std::atomic<std::uint64_t> try_fails{0};       // try_lock() that returned false
+    std::atomic<std::int64_t> wait_ns{0};
+    std::atomic<std::int64_t> max_wait_ns{0};
+    std::atomic<std::int64_t> hold_ns{0};
+
+    void on_acquire(std::int64_t wait, bool was_contended) {
+        acquires.fetch_add(1, std::memory_order_relaxed);
+        if (!was_contended) return;
+        contended.fetch_add(1, std::memory_order_relaxed);
+        wait_ns.fetch_add(wait, std::memory_order_relaxed);
+        std::int64_t m = max_wait_ns.load(std::memory_order_relaxed);
+        while (wait > m && !max_wait_ns.compare_exchange_weak(m, wait, std::memory_order_relaxed)) {}
+    }
+    void on_release(std::int64_t hold) { hold_ns.fetch_add(hold, std::memory_order_relaxed); }
+};
+
+// Fixed open-addressed table keyed by a pointer (call-site address or lock
+// name). Entries are never removed, so a Stats* stays valid forever and
+// locks may come and go.
+class Table {
+public:
+    static constexpr std::size_t kSlots = 1024;
+
+    struct Entry {
+        std::atomic<const void*> key{nullptr};
+        std::atomic<const char*> lock{nullptr};    // lock name, for call sites
+        Stats stats;
+    };
+
+    Entry& find(const void* key, const char* lock_name) {
+        std::size_t h = (reinterpret_cast<std::uintptr_t>(key) >> 4) * 0x9E3779B97F4A7C15ull >> 54;
+        for (std::size_t probe = 0; probe < kSlots; ++probe, h = (h + 1) & (kSlots - 1)) {
+            Entry& e = slots_[h];
+            const void* k = e.key.load(std::memory_order_acquire);
+            if (k == key) return e;
+            if (k == nullptr) {
+                if (e.key.compare_exchange_strong(k, key, std::memory_order_acq_rel)) {
+                    e.lock.store(lock_name, std::memory_order_release);
+                    return e;
+                }
+                if (k == key) return e;
+            }
+        }
+        return overflow_;           // table full: lumped together
+    }
+
+    template<class Fn>
+    void for_each(Fn&& fn) const {
+        for (const Entry& e : slots_)
+            if (e.key.load(std::memory_order_acquire)) fn(e);
+    }
+
+    void reset() {
+        for (Entry& e : slots_) {
+            Stats& s = e.stats;
+            s.acquires = 0; s.contended = 0; s.try_fails = 0;
+            s.wait_ns = 0; s.max_wait_ns = 0; s.hold_ns = 0;
+        }
+    }
+
+private:
+    Entry slots_[kSlots];
+    Entry overflow_;
+};
+
+inline Table& locks() { static Table t; return t; }
+inline Table& sites() { static Table t; return t; }
+
+inline std::int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class ProfiledMutex {
+public:
+    explicit ProfiledMutex(const char* name = "unnamed") { set_name(name); }
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+    // `name` must outlive the program's last report (a string literal).
+    void set_name(const char* name) {
+        name_ = name;
+        lock_ = &locks().find(name, name).stats;
+    }
+
+    // noinline keeps the return address pointing at the caller.
+    __attribute__((noinline)) void lock() {
+        const void* site = __builtin_return_address(0);
+        std::int64_t wait = 0;
+        bool waited = !m_.try_lock();
+        if (waited) {
+            std::int64_t t0 = now_ns();
+            m_.lock();
+            wait = now_ns() - t0;
+        }
+        acquired(site, wait, waited);
+    }
+
+    __attribute__((noinline)) bool try_lock() {
+        if (!m_.try_lock()) {
+            lock_->try_fails.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        acquired(__builtin_return_address(0), 0, false);
+        return true;
+    }
+
+    void unlock() {
+        const std::int64_t hold = now_ns() - acquired_at_;
+        Stats* site = site_;
+        m_.unlock();
+        lock_->on_release(hold);
+        site->on_release(hold);
+    }
+
+private:
+    void acquired(const void* site_addr, std::int64_t wait, bool waited) {
+        Stats* site = &sites().find(site_addr, name_).stats;
+        lock_->on_acquire(wait, waited);
+        site->on_acquire(wait, waited);
+        site_ = site;                   // owner-only fields, written under m_
+        acquired_at_ = now_ns();
+    }
+
+    std::mutex m_;
+    const char* name_ = nullptr;
+    Stats* lock_ = nullptr;
+    Stats* site_ = nullptr;
+    std::int64_t acquired_at_ = 0;
+};
+
+inline void name(ProfiledMutex& m, const char* n) { m.set_name(n); }
+
+inline std::string symbolize(const void* addr) {
+    Dl_info info;
+    if (dladdr(addr, &info) && info.dli_sname) {
+        int status = 0;
+        char* dem = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string s = status == 0 && dem ? dem : info.dli_sname;
+        std::free(dem);
+        if (s.size() > 70) s = s.substr(0, 67) + "...";
+        char off[32];
+        std::snprintf(off, sizeof(off), "+0x%zx",
+                      static_cast<std::size_t>(static_cast<const char*>(addr) - static_cast<const char*>(info.dli_saddr)));
+        return s + off;
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%p", addr);
+    return buf;
+}
+
+struct Row {
+    std::string what;
+    const char* lock;
+    std::uint64_t acquires, contended, try_fails;
+    double wait_ms, max_wait_us, hold_ms;
+};
+
+inline std::vector<Row> rows(const Table& t, bool by_site) {
+    std::vector<Row> out;
+    t.for_each([&](const Table::Entry& e) {
+        const Stats& s = e.stats;
+        if (!s.acquires.load() && !s.try_fails.load()) return;
+        const char* lock = e.lock.load();
+        out.push_back({by_site ? symbolize(e.key.load()) : std::string(lock), lock,
+                       s.acquires.load(), s.contended.load(), s.try_fails.load(),
+                       s.wait_ns.load() / 1e6, s.max_wait_ns.load() / 1e3, s.hold_ns.load() / 1e6});
+    });
+    std::sort(out.begin(), out.end(), [](const Row& a, const Row& b) {
+        return a.wait_ms != b.wait_ms ? a.wait_ms > b.wait_ms : a.hold_ms > b.hold_ms;
+    });
+    return out;
+}
+
+inline void print_rows(std::ostream& os, const std::vector<Row>& rs, std::size_t top, bool by_site) {
+    os << "  " << std::left << std::setw(by_site ? 20 : 22) << "lock" << std::right
+       << std::setw(10) << "acquires" << std::setw(11) << "contended" << std::setw(8) << "%" << std::setw(12) << "wait ms"
+       << std::setw(13) << "avg wait us" << std::setw(13) << "max wait us" << std::setw(11) << "hold ms"
+       << std::setw(13) << "avg hold us" << (by_site ? "  call site" : "") << "\n";
+    for (std::size_t i = 0; i < rs.size() && i < top; ++i) {
+        const Row& r = rs[i];
+        double pct = r.acquires ? 100.0 * static_cast<double>(r.contended) / static_cast<double>(r.acquires) : 0;
+        os << "  " << std::left << std::setw(by_site ? 20 : 22) << r.lock << std::right << std::fixed
+           << std::setw(10) << r.acquires << std::setw(11) << r.contended
+           << std::setw(8) << std::setprecision(2) << pct
+           << std::setw(12) << std::setprecision(2) << r.wait_ms
+           << std::setw(13) << (r.contended ? r.wait_ms * 1e3 / static_cast<double>(r.contended) : 0.0)
+           << std::setw(13) << r.max_wait_us
+           << std::setw(11) << r.hold_ms
+           << std::setw(13) << (r.acquires ? r.hold_ms * 1e3 / static_cast<double>(r.acquires) : 0.0);
+        if (by_site) os << "  " << r.what;
+        os << "\n";
+    }
+}
+
+// Hottest locks and call sites, by total time spent waiting.
+inline void report(std::ostream& os = std::cout, std::size_t top = 10) {
+    os << "hottest locks:\n";
+    print_rows(os, rows(locks(), false), top, false);
+    os << "hottest call sites:\n";
+    print_rows(os, rows(sites(), true), top, true);
+}
+
+inline void reset() {
+    locks().reset();
+    sites().reset();
+}
+
+constexpr bool enabled = true;
+
+#else   // !LOCK_PROFILE
+
+using ProfiledMutex = std::mutex;
+inline void report(std::ostream& os = std::cout, std::size_t = 10) {
+    os << "lock profiling is off (build with -DLOCK_PROFILE -rdynamic)\n";
+}
+inline void reset() {}
+constexpr bool enabled = false;
+
+#endif
+
+// std::condition_variable only works with std::mutex.
+template<class Mutex>
+using cv_for = std::conditional_t<std::is_same<Mutex, std::mutex>::value,
+                                  std::condition_variable, std::condition_variable_any>;
+
+} // namespace lockprof
+
+// ---------------- TSQueue (as in code2, mutex as a parameter) ----------------
+template <class T, class Mutex = std::mutex>
+class TSQueue {
+public:
+    TSQueue() : closed_(false) { lockprof::name(m_, "TSQueue::m_"); }
+
+    TSQueue(const TSQueue&) = delete;
+    TSQueue& operator=(const TSQueue&) = delete;
+
+    bool push(T&& v) {
+        std::lock_guard<Mutex> lk(m_);
+        if (closed_) return false;
+        q_.push(std::move(v));
+        cv_.notify_one();
+        return true;
+    }
+
+    bool wait_pop(T& out) {
+        std::unique_lock<Mutex> lk(m_);
+        cv_.wait(lk, [this]{ return closed_ || !q_.empty(); });
+        if (q_.empty()) return false;
+        out = std::move(q_.front());
+        q_.pop();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<Mutex> lk(m_);
+        closed_ = true;
+        cv_.notify_all();
+    }
+
+private:
+    mutable Mutex m_;
+    lockprof::cv_for<Mutex> cv_;
+    std::queue<T> q_;
+    bool closed_;
+};
+
+// ---------------- ThreadPool (as in code2, mutex as a parameter) ----------------
+template <class Mutex = std::mutex>
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency()) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this]{
+                std::function<void()> task;
+                while (tasks_.wait_pop(task)) {
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        if (!tasks_.push([pkg]{ (*pkg)(); }))
+            throw std::runtime_error("submit on stopped pool");
+        return fut;
+    }
+
+    ~ThreadPool() {
+        tasks_.close();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    TSQueue<std::function<void()>, Mutex> tasks_;
+    std::vector<std::thread> workers_;
+};
+
+// ---------------- Demo ----------------
+using clock_type = std::chrono::steady_clock;
+
+// Jobs record results in a shared map: a common pattern, and the per-result
+// formatting inside the lock makes this the convoy the report should find.
+template<class Mutex>
+struct ResultLog {
+    ResultLog() { lockprof::name(m, "ResultLog::m"); }
+
+    void record(int id, long value) {
+        std::lock_guard<Mutex> lk(m);
+        by_id[id] = "job " + std::to_string(id) + " -> " + std::to_string(value);
+    }
+
+    Mutex m;
+    std::map<int, std::string> by_id;
+};
+
+template<class Mutex>
+double run(int producers, int jobs_per_producer) {
+    ThreadPool<Mutex> pool(4);
+    ResultLog<Mutex> log;
+    auto s = clock_type::now();
+    std::vector<std::thread> ps;
+    for (int p = 0; p < producers; ++p)
+        ps.emplace_back([&, p]{
+            std::vector<std::future<void>> futs;
+            futs.reserve(jobs_per_producer);
+            for (int i = 0; i < jobs_per_producer; ++i) {
+                int id = p * jobs_per_producer + i;
+                futs.push_back(pool.submit([&log, id]{
+                    long v = 0;
+                    for (int k = 0; k < 200; ++k) v += k ^ id;
+                    log.record(id, v);
+                }));
+            }
+            for (auto& f : futs) f.get();
+        });
+    for (auto& t : ps) t.join();
+    return std::chrono::duration<double, std::milli>(clock_type::now() - s).count();
+}
+
+int main() {
+    const int producers = 4, jobs = 50'000;
+    double plain = run<std::mutex>(producers, jobs);
+    lockprof::reset();
+    double profiled = run<lockprof::ProfiledMutex>(producers, jobs);
+
+    std::cout << producers * jobs << " jobs, " << producers << " producers, 4 workers\n"
+              << std::fixed << std::setprecision(1)
+              << "  std::mutex:              " << plain << " ms\n"
+              << "  lockprof::ProfiledMutex: " << profiled << " ms"
+              << (lockprof::enabled ? "" : " (same type: profiling off)") << "\n\n";
+    lockprof::report();
+}
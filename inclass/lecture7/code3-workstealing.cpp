@@ -0,0 +1,267 @@
+// work_stealing_pool.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code3-workstealing.cpp -o code3
+//
+// Same submit/enqueue API as code1/code2, but every worker owns its own deque:
+//   - the owner pushes/pops at the BACK  (LIFO, cache-warm, no sharing)
+//   - idle workers steal from the FRONT  (FIFO, oldest = usually biggest work)
+// Tasks submitted from inside a task stay on the submitting worker's deque.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ---------------- ThreadPool (single shared queue, as in code1) ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.emplace([pkg]{ (*pkg)(); });
+        }
+        cv_.notify_one();
+        return fut;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- WorkStealingPool ----------------
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(std::size_t n = std::thread::hardware_concurrency()) {
+        if (!n) n = 1;
+        queues_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            queues_.push_back(std::make_unique<WorkQueue>());
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            workers_.emplace_back([this, i]{ worker_loop(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Fire-and-forget
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit and get future
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        if (stop_.load(std::memory_order_acquire))
+            throw std::runtime_error("submit on stopped pool");
+        push([pkg]{ (*pkg)(); });
+        return fut;
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lk(idle_m_);
+            stop_.store(true, std::memory_order_release);
+        }
+        idle_cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    // One deque per worker. The lock is only ever shared between the owner
+    // and an occasional thief, so it is almost always uncontended.
+    struct WorkQueue {
+        std::mutex m;
+        std::deque<std::function<void()>> dq;
+    };
+
+    void push(std::function<void()> task) {
+        std::size_t idx;
+        if (tls_pool_ == this) {
+            idx = tls_index_;                                   // stay local
+        } else {
+            idx = next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        }
+        {
+            std::lock_guard<std::mutex> lk(queues_[idx]->m);
+            queues_[idx]->dq.push_back(std::move(task));
+        }
+        // Pairs with worker_loop: a worker registers in sleepers_ before it
+        // re-checks pending_, so either it sees this task or we see it. Only
+        // then do we need idle_m_ (empty critical section) to close the window
+        // between its check and its cv wait.
+        pending_.fetch_add(1);
+        if (sleepers_.load() == 0) return;
+        { std::lock_guard<std::mutex> lk(idle_m_); }
+        idle_cv_.notify_one();
+    }
+
+    bool pop_local(std::size_t i, std::function<void()>& out) {
+        WorkQueue& wq = *queues_[i];
+        std::lock_guard<std::mutex> lk(wq.m);
+        if (wq.dq.empty()) return false;
+        out = std::move(wq.dq.back());
+        wq.dq.pop_back();
+        return true;
+    }
+
+    bool steal(std::size_t thief, std::function<void()>& out) {
+        const std::size_t n = queues_.size();
+        for (std::size_t k = 1; k < n; ++k) {
+            WorkQueue& wq = *queues_[(thief + k) % n];
+            std::unique_lock<std::mutex> lk(wq.m, std::try_to_lock);
+            if (!lk.owns_lock() || wq.dq.empty()) continue;     // busy/empty: try next victim
+            out = std::move(wq.dq.front());
+            wq.dq.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void worker_loop(std::size_t i) {
+        tls_pool_ = this;
+        tls_index_ = i;
+        std::function<void()> task;
+        for (;;) {
+            if (pop_local(i, task) || steal(i, task)) {
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                try { task(); } catch (...) { /* swallow/log */ }
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(idle_m_);
+            sleepers_.fetch_add(1);
+            idle_cv_.wait(lk, [this]{
+                return stop_.load(std::memory_order_relaxed) || pending_.load() > 0;
+            });
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+            if (stop_.load(std::memory_order_relaxed) &&
+                pending_.load(std::memory_order_acquire) == 0) return;   // drained
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> next_{0};      // round-robin target for external submits
+    std::atomic<std::size_t> pending_{0};   // tasks pushed but not yet taken
+    std::atomic<std::size_t> sleepers_{0};  // workers in (or entering) idle_cv_.wait
+    std::atomic<bool> stop_{false};
+    std::mutex idle_m_;                     // only touched when a worker goes idle
+    std::condition_variable idle_cv_;
+
+    inline static thread_local WorkStealingPool* tls_pool_ = nullptr;
+    inline static thread_local std::size_t tls_index_ = 0;
+};
+
+// ---------------- Demo ----------------
+int add(int a, int b) { return a + b; }
+
+// Binary fan-out: each task spawns two children from inside the pool until
+// depth runs out. Callers only change the Pool type.
+template <class Pool>
+void spawn_tree(Pool& pool, int depth, std::atomic<long>& leaves,
+                std::atomic<long>& outstanding, std::promise<void>& done) {
+    if (depth == 0) {
+        leaves.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        outstanding.fetch_add(2, std::memory_order_relaxed);
+        for (int c = 0; c < 2; ++c)
+            pool.enqueue([&pool, depth, &leaves, &outstanding, &done]{
+                spawn_tree(pool, depth - 1, leaves, outstanding, done);
+            });
+    }
+    if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) done.set_value();
+}
+
+template <class Pool>
+void run_demo(const char* name) {
+    using clock_type = std::chrono::steady_clock;
+    Pool pool(4);
+
+    auto f1 = pool.submit(add, 21, 21);
+    auto f2 = pool.submit([](int x){ return x * x; }, 12);
+    std::cout << "[" << name << "] add: " << f1.get() << "\n";   // 42
+    std::cout << "[" << name << "] sq : " << f2.get() << "\n";   // 144
+
+    const int depth = 16;                                        // 65536 leaves
+    std::atomic<long> leaves{0}, outstanding{1};
+    std::promise<void> done;
+    auto s = clock_type::now();
+    pool.enqueue([&]{ spawn_tree(pool, depth, leaves, outstanding, done); });
+    done.get_future().wait();
+    auto e = clock_type::now();
+
+    std::cout << "[" << name << "] leaves: " << leaves.load()
+              << " (expected " << (1L << depth) << ") in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count()
+              << " ms\n";
+}
+
+int main() {
+    run_demo<ThreadPool>("shared-queue");
+    run_demo<WorkStealingPool>("work-stealing");
+}
@@ -0,0 +1,443 @@
+// ring_buffer_queue.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code4-ringbuffer.cpp -o code4
+//
+// RingQueue<T>: bounded, lock-free MPMC ring buffer (sequence-numbered cells,
+// one atomic ticket per side) with the same push/emplace/try_pop/wait_pop/close
+// surface as TSQueue from code2. Differences:
+//   - fixed capacity, no allocation after construction
+//   - push blocks when full (back-pressure) instead of growing
+//   - waiters spin briefly, then park on a condition variable; producers and
+//     consumers only touch the mutex when someone is actually parked
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+constexpr std::size_t kCacheLine = 64;
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// ---------------- TSQueue (thread-safe, closeable; as in code2) ----------------
+template <class T>
+class TSQueue {
+public:
+    TSQueue() : closed_(false) {}
+
+    TSQueue(const TSQueue&) = delete;
+    TSQueue& operator=(const TSQueue&) = delete;
+
+    bool push(const T& v) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (closed_) return false;
+        q_.push(v);
+        cv_.notify_one();
+        return true;
+    }
+    bool push(T&& v) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (closed_) return false;
+        q_.push(std::move(v));
+        cv_.notify_one();
+        return true;
+    }
+    template<class... Args>
+    bool emplace(Args&&... args) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (closed_) return false;
+        q_.emplace(std::forward<Args>(args)...);
+        cv_.notify_one();
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (q_.empty()) return false;
+        out = std::move(q_.front());
+        q_.pop();
+        return true;
+    }
+
+    bool wait_pop(T& out) {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [this]{ return closed_ || !q_.empty(); });
+        if (q_.empty()) return false; // closed and drained
+        out = std::move(q_.front());
+        q_.pop();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lk(m_);
+        closed_ = true;
+        cv_.notify_all();
+    }
+
+private:
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    std::queue<T> q_;
+    bool closed_;
+};
+
+// ---------------- RingQueue (bounded, lock-free MPMC) ----------------
+template <class T>
+class RingQueue {
+public:
+    // capacity is rounded up to a power of two.
+    // spin_limit: how many failed attempts a waiter makes before parking
+    // (0 = park immediately, like TSQueue). Spinning on a single core only
+    // delays the thread we are waiting for, so it is disabled there.
+    explicit RingQueue(std::size_t capacity = 1024, std::size_t spin_limit = 256)
+    : spin_limit_(std::thread::hardware_concurrency() > 1 ? spin_limit : 0) {
+        std::size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        cells_.reset(new Cell[cap]);
+        for (std::size_t i = 0; i < cap; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    ~RingQueue() {
+        T tmp;
+        while (try_pop(tmp)) {}                 // destroy anything left behind
+    }
+
+    // Producers: block while full, return false once closed.
+    bool push(const T& v) { return emplace(v); }
+    bool push(T&& v)      { return emplace(std::move(v)); }
+
+    template<class... Args>
+    bool emplace(Args&&... args) {
+        ProducerGuard g(*this);
+        if (closed_.load(std::memory_order_seq_cst)) return false;
+        for (std::size_t spin = 0; ; ++spin) {
+            if (try_emplace_impl(std::forward<Args>(args)...)) {
+                wake(empty_waiters_, not_empty_);
+                return true;
+            }
+            if (closed_.load(std::memory_order_relaxed)) return false;
+            if (spin < spin_limit_) { cpu_relax(); continue; }
+
+            // Park until a consumer frees a slot (or we are closed).
+            std::unique_lock<std::mutex> lk(park_m_);
+            full_waiters_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool ok = false;
+            not_full_.wait(lk, [&]{
+                ok = try_emplace_impl(std::forward<Args>(args)...);
+                return ok || closed_.load(std::memory_order_relaxed);
+            });
+            full_waiters_.fetch_sub(1, std::memory_order_relaxed);
+            lk.unlock();
+            if (ok) wake(empty_waiters_, not_empty_);
+            return ok;
+        }
+    }
+
+    // Non-blocking producer: false if full or closed.
+    bool try_push(T&& v) {
+        ProducerGuard g(*this);
+        if (closed_.load(std::memory_order_seq_cst)) return false;
+        if (!try_emplace_impl(std::move(v))) return false;
+        wake(empty_waiters_, not_empty_);
+        return true;
+    }
+
+    // Consumers
+    bool try_pop(T& out) {
+        if (!try_pop_impl(out)) return false;
+        wake(full_waiters_, not_full_);
+        return true;
+    }
+
+    // Blocks until item available OR queue is closed & drained.
+    // Returns false only when closed and empty.
+    bool wait_pop(T& out) {
+        for (std::size_t spin = 0; ; ++spin) {
+            if (try_pop(out)) return true;
+            if (drained()) return false;
+            if (spin < spin_limit_) { cpu_relax(); continue; }
+
+            std::unique_lock<std::mutex> lk(park_m_);
+            empty_waiters_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool ok = false, done = false;
+            not_empty_.wait(lk, [&]{
+                ok = try_pop_impl(out);
+                done = !ok && drained();
+                return ok || done;
+            });
+            empty_waiters_.fetch_sub(1, std::memory_order_relaxed);
+            lk.unlock();
+            if (ok) { wake(full_waiters_, not_full_); return true; }
+            if (done) return false;
+        }
+    }
+
+    // Shutdown producers and wake all waiters.
+    void close() {
+        closed_.store(true, std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lk(park_m_);
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    // Approximate under concurrency, exact when quiescent.
+    std::size_t size() const {
+        std::size_t t = tail_.load(std::memory_order_acquire);
+        std::size_t h = head_.load(std::memory_order_acquire);
+        return t > h ? t - h : 0;
+    }
+    bool empty() const { return size() == 0; }
+    std::size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct alignas(kCacheLine) Cell {
+        std::atomic<std::size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+        T* ptr() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    // Counts producers between "checked closed_" and "published the item",
+    // so consumers never report drained while a push is still landing.
+    struct ProducerGuard {
+        explicit ProducerGuard(RingQueue& q) : q_(q) {
+            q_.producers_.fetch_add(1, std::memory_order_seq_cst);
+        }
+        ~ProducerGuard() {
+            if (q_.producers_.fetch_sub(1, std::memory_order_seq_cst) == 1 &&
+                q_.closed_.load(std::memory_order_seq_cst))
+                q_.wake_all(q_.not_empty_);
+        }
+        RingQueue& q_;
+    };
+
+    template<class... Args>
+    bool try_emplace_impl(Args&&... args) {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells_[pos & mask_];
+            std::size_t seq = c.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    ::new (static_cast<void*>(c.storage)) T(std::forward<Args>(args)...);
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;                   // full
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop_impl(T& out) {
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells_[pos & mask_];
+            std::size_t seq = c.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* p = c.ptr();
+                    out = std::move(*p);
+                    p->~T();
+                    c.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;                   // empty
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool drained() const {
+        return closed_.load(std::memory_order_seq_cst) &&
+               producers_.load(std::memory_order_seq_cst) == 0 &&
+               empty();
+    }
+
+    // Never called with park_m_ held.
+    // Fast path is a single load: no waiter, no mutex, no syscall.
+    void wake(std::atomic<int>& waiters, std::condition_variable& cv) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0) return;
+        std::lock_guard<std::mutex> lk(park_m_);
+        cv.notify_one();
+    }
+    void wake_all(std::condition_variable& cv) {
+        std::lock_guard<std::mutex> lk(park_m_);
+        cv.notify_all();
+    }
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_ = 0;
+    std::size_t spin_limit_;
+
+    alignas(kCacheLine) std::atomic<std::size_t> tail_{0};   // producers' ticket
+    alignas(kCacheLine) std::atomic<std::size_t> head_{0};   // consumers' ticket
+    alignas(kCacheLine) std::atomic<bool> closed_{false};
+    std::atomic<int> producers_{0};
+    std::atomic<int> empty_waiters_{0};
+    std::atomic<int> full_waiters_{0};
+    std::mutex park_m_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+// ---------------- ThreadPool, parameterised on the queue ----------------
+template <template<class> class Queue>
+class BasicThreadPool {
+public:
+    template<class... QueueArgs>
+    explicit BasicThreadPool(std::size_t n, QueueArgs&&... qargs)
+    : tasks_(std::forward<QueueArgs>(qargs)...) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this]{
+                std::function<void()> task;
+                while (tasks_.wait_pop(task)) {
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        if (!tasks_.emplace([pkg]{ (*pkg)(); })) {
+            throw std::runtime_error("submit on stopped pool");
+        }
+        return fut;
+    }
+
+    void shutdown() {
+        tasks_.close();
+    }
+
+    ~BasicThreadPool() {
+        tasks_.close(); // signal shutdown
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    Queue<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+};
+
+using ThreadPool     = BasicThreadPool<TSQueue>;
+using RingThreadPool = BasicThreadPool<RingQueue>;
+
+// ---------------- Demo ----------------
+int add(int a, int b) { return a + b; }
+
+// P producers push ITEMS each, C consumers drain; checks nothing is lost.
+template <class Q>
+long long bench_mpmc(Q& q, int producers, int consumers, int items) {
+    using clock_type = std::chrono::steady_clock;
+    std::atomic<long long> sum{0};
+    auto s = clock_type::now();
+    std::vector<std::thread> cs, ps;
+    for (int c = 0; c < consumers; ++c)
+        cs.emplace_back([&]{
+            long long local = 0; int v;
+            while (q.wait_pop(v)) local += v;
+            sum.fetch_add(local, std::memory_order_relaxed);
+        });
+    for (int p = 0; p < producers; ++p)
+        ps.emplace_back([&]{ for (int i = 1; i <= items; ++i) q.push(i); });
+    for (auto& t : ps) t.join();
+    q.close();
+    for (auto& t : cs) t.join();
+    auto e = clock_type::now();
+
+    long long expected = 1LL * producers * items * (items + 1) / 2;
+    if (sum.load() != expected) std::cerr << "wrong: " << sum.load() << "\n";
+    return std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count();
+}
+
+int main() {
+    {
+        RingThreadPool pool(4, 256);      // 4 workers, 256-slot ring
+
+        for (int i = 0; i < 6; ++i)
+            pool.enqueue([i]{
+                std::cout << "Task " << i
+                          << " on thread " << std::this_thread::get_id() << "\n";
+            });
+
+        auto f1 = pool.submit(add, 21, 21);
+        auto f2 = pool.submit([](int x){ return x * x; }, 12);
+
+        std::cout << "add: " << f1.get() << "\n";   // 42
+        std::cout << "sq : " << f2.get() << "\n";   // 144
+    }
+
+    // Back-pressure: with a 4-slot ring and a 1ms consumer, the producer is
+    // held back to the consumer's pace instead of queueing all 32 items.
+    {
+        using clock_type = std::chrono::steady_clock;
+        RingQueue<int> q(4);
+        std::thread consumer([&]{
+            int v;
+            while (q.wait_pop(v))
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+        auto s = clock_type::now();
+        for (int i = 0; i < 32; ++i) q.push(i);
+        auto e = clock_type::now();
+        q.close();
+        consumer.join();
+        std::cout << "back-pressure: producer held for "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count()
+                  << " ms (capacity " << q.capacity() << ")\n";
+    }
+
+    const int P = 4, C = 4, N = 500'000;
+    TSQueue<int> tsq;
+    RingQueue<int> ring(1024);
+    auto t = bench_mpmc(tsq, P, C, N);
+    auto r = bench_mpmc(ring, P, C, N);
+    std::cout << "TSQueue:   " << t << " ms\n";
+    std::cout << "RingQueue: " << r << " ms\n";
+}
@@ -0,0 +1,446 @@
+// inline_task_pool.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code5-inline-task.cpp -o code5
+//
+// code1's submit() pays three heap allocations per job before any work runs:
+//   make_shared<packaged_task>  +  std::bind state  +  std::function storage.
+// This version replaces them with:
+//   - InlineTask : move-only callable with 64 bytes of inline storage
+//                  (falls back to the heap only for oversized callables)
+//   - TaskPromise/TaskFuture : one shared state, recycled through free
+//                  lists, so steady-state submits allocate nothing
+//   - a growable ring of InlineTasks in the pool (grows, never shrinks)
+// Exceptions thrown by the job still reach the caller through get().
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ---------------- allocation counter (demo only) ----------------
+static std::atomic<long> g_allocs{0};
+
+void* operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// ---------------- InlineTask ----------------
+class InlineTask {
+public:
+    static constexpr std::size_t kInlineSize = 64;
+
+    InlineTask() noexcept = default;
+
+    template<class F, class D = std::decay_t<F>,
+             class = std::enable_if_t<!std::is_same<D, InlineTask>::value>>
+    InlineTask(F&& f) {
+        if constexpr (fits_inline<D>()) {
+            ::new (static_cast<void*>(buf_)) D(std::forward<F>(f));
+            vt_ = &inline_vtable<D>;
+        } else {
+            ::new (static_cast<void*>(buf_)) D*(new D(std::forward<F>(f)));
+            vt_ = &heap_vtable<D>;
+        }
+    }
+
+    InlineTask(InlineTask&& o) noexcept : vt_(o.vt_) {
+        if (vt_) { vt_->move(buf_, o.buf_); o.vt_ = nullptr; }
+    }
+    InlineTask& operator=(InlineTask&& o) noexcept {
+        if (this != &o) {
+            reset();
+            vt_ = o.vt_;
+            if (vt_) { vt_->move(buf_, o.buf_); o.vt_ = nullptr; }
+        }
+        return *this;
+    }
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    ~InlineTask() { reset(); }
+
+    explicit operator bool() const noexcept { return vt_ != nullptr; }
+    void operator()() { vt_->invoke(buf_); }
+
+    void reset() noexcept {
+        if (vt_) { vt_->destroy(buf_); vt_ = nullptr; }
+    }
+
+private:
+    struct VTable {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src) noexcept;    // move-construct dst, destroy src
+        void (*destroy)(void*) noexcept;
+    };
+
+    template<class D>
+    static constexpr bool fits_inline() {
+        return sizeof(D) <= kInlineSize &&
+               alignof(D) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<D>::value;
+    }
+
+    template<class D>
+    static constexpr VTable inline_vtable = {
+        [](void* p) { (*static_cast<D*>(p))(); },
+        [](void* dst, void* src) noexcept {
+            ::new (dst) D(std::move(*static_cast<D*>(src)));
+            static_cast<D*>(src)->~D();
+        },
+        [](void* p) noexcept { static_cast<D*>(p)->~D(); },
+    };
+
+    template<class D>
+    static constexpr VTable heap_vtable = {
+        [](void* p) { (**static_cast<D**>(p))(); },
+        [](void* dst, void* src) noexcept {
+            ::new (dst) D*(*static_cast<D**>(src));
+        },
+        [](void* p) noexcept { delete *static_cast<D**>(p); },
+    };
+
+    alignas(std::max_align_t) unsigned char buf_[kInlineSize];
+    const VTable* vt_ = nullptr;
+};
+
+// ---------------- TaskPromise / TaskFuture ----------------
+namespace detail {
+
+struct Unit {};
+
+template<class R>
+class SharedState {
+public:
+    using Stored = std::conditional_t<std::is_void<R>::value, Unit, R>;
+
+    // States are recycled: each thread keeps a small free list, and spills to or
+    // refills from a shared list in batches. Promises are usually released on
+    // a worker and futures on the submitter, so states migrate between threads
+    // and the shared list is what keeps the submitter from allocating.
+    static SharedState* acquire() {
+        FreeList& fl = local_list();
+        if (!fl.head) refill(fl);
+        SharedState* s = fl.pop();
+        if (!s) s = new SharedState();
+        s->refs_.store(2, std::memory_order_relaxed);   // one promise + one future
+        s->ready_ = false;
+        return s;
+    }
+
+    void release() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        value_.reset();
+        error_ = nullptr;
+        FreeList& fl = local_list();
+        fl.push(this);
+        if (fl.size >= 2 * kBatch) spill(fl);
+    }
+
+    template<class... V>
+    void set_value(V&&... v) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            value_.emplace(std::forward<V>(v)...);
+            ready_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    void set_exception(std::exception_ptr e) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            error_ = std::move(e);
+            ready_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [this]{ return ready_; });
+    }
+
+    bool is_ready() {
+        std::lock_guard<std::mutex> lk(m_);
+        return ready_;
+    }
+
+    Stored take() {
+        wait();
+        if (error_) std::rethrow_exception(error_);
+        return std::move(*value_);
+    }
+
+private:
+    static constexpr std::size_t kBatch = 64;
+
+    struct FreeList {
+        SharedState* head = nullptr;
+        std::size_t size = 0;
+
+        void push(SharedState* s) { s->next_free_ = head; head = s; ++size; }
+        SharedState* pop() {
+            SharedState* s = head;
+            if (s) { head = s->next_free_; --size; }
+            return s;
+        }
+        ~FreeList() {
+            while (SharedState* s = pop()) delete s;
+        }
+    };
+
+    static FreeList& local_list() {
+        static thread_local FreeList fl;
+        return fl;
+    }
+
+    struct GlobalList {
+        std::mutex m;
+        FreeList list;
+    };
+    static GlobalList& global_list() {
+        static GlobalList gl;
+        return gl;
+    }
+
+    static void refill(FreeList& fl) {
+        GlobalList& gl = global_list();
+        std::lock_guard<std::mutex> lk(gl.m);
+        for (std::size_t i = 0; i < kBatch; ++i) {
+            SharedState* s = gl.list.pop();
+            if (!s) break;
+            fl.push(s);
+        }
+    }
+
+    static void spill(FreeList& fl) {
+        GlobalList& gl = global_list();
+        std::lock_guard<std::mutex> lk(gl.m);
+        for (std::size_t i = 0; i < kBatch; ++i) gl.list.push(fl.pop());
+    }
+
+    std::atomic<int> refs_{0};
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool ready_ = false;
+    std::optional<Stored> value_;
+    std::exception_ptr error_;
+    SharedState* next_free_ = nullptr;
+};
+
+} // namespace detail
+
+template<class R>
+class TaskFuture {
+public:
+    TaskFuture() = default;
+    TaskFuture(TaskFuture&& o) noexcept : st_(std::exchange(o.st_, nullptr)) {}
+    TaskFuture& operator=(TaskFuture&& o) noexcept {
+        if (this != &o) { drop(); st_ = std::exchange(o.st_, nullptr); }
+        return *this;
+    }
+    ~TaskFuture() { drop(); }
+
+    bool valid() const noexcept { return st_ != nullptr; }
+    bool is_ready() const { return st_ && st_->is_ready(); }
+    void wait() const { st_->wait(); }
+
+    // One-shot, like std::future::get(): rethrows the job's exception.
+    R get() {
+        if (!st_) throw std::future_error(std::future_errc::no_state);
+        auto* st = std::exchange(st_, nullptr);
+        struct Release { detail::SharedState<R>* s; ~Release() { s->release(); } } rel{st};
+        if constexpr (std::is_void<R>::value) { st->take(); }
+        else                                  { return st->take(); }
+    }
+
+private:
+    template<class> friend class TaskPromise;
+    explicit TaskFuture(detail::SharedState<R>* st) : st_(st) {}
+    void drop() { if (st_) { st_->release(); st_ = nullptr; } }
+
+    detail::SharedState<R>* st_ = nullptr;
+};
+
+template<class R>
+class TaskPromise {
+public:
+    TaskPromise() : st_(detail::SharedState<R>::acquire()) {}
+    TaskPromise(TaskPromise&& o) noexcept : st_(std::exchange(o.st_, nullptr)),
+                                            future_taken_(o.future_taken_) {}
+    TaskPromise& operator=(TaskPromise&&) = delete;
+    ~TaskPromise() {
+        if (!st_) return;
+        if (!satisfied_)
+            st_->set_exception(std::make_exception_ptr(
+                std::future_error(std::future_errc::broken_promise)));
+        if (!future_taken_) st_->release();             // nobody will release the future's ref
+        st_->release();
+    }
+
+    TaskFuture<R> get_future() {
+        future_taken_ = true;
+        return TaskFuture<R>(st_);
+    }
+
+    // Runs fn and stores its result or exception, like packaged_task::operator().
+    template<class Fn>
+    void run(Fn&& fn) {
+        try {
+            if constexpr (std::is_void<R>::value) { fn(); st_->set_value(); }
+            else                                  { st_->set_value(fn()); }
+        } catch (...) {
+            st_->set_exception(std::current_exception());
+        }
+        satisfied_ = true;
+    }
+
+private:
+    detail::SharedState<R>* st_;
+    bool future_taken_ = false;
+    bool satisfied_ = false;
+};
+
+// ---------------- ThreadPool (InlineTask ring, no per-job allocation) ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency(),
+                        std::size_t initial_capacity = 1024)
+    : ring_(initial_capacity ? initial_capacity : 1) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    InlineTask task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || count_ != 0; });
+                        if (stop_ && count_ == 0) return;
+                        task = std::move(ring_[head_]);
+                        head_ = (head_ + 1) % ring_.size();
+                        --count_;
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    // Fire-and-forget: just ignore the returned future
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit and get a future result
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a) -> TaskFuture<std::invoke_result_t<F, A...>> {
+        using R = std::invoke_result_t<F, A...>;
+        TaskPromise<R> p;
+        auto fut = p.get_future();
+        push(InlineTask(
+            [p = std::move(p), fn = std::forward<F>(f),
+             args = std::make_tuple(std::forward<A>(a)...)]() mutable {
+                p.run([&]() -> R { return std::apply(fn, std::move(args)); });
+            }));
+        return fut;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    void push(InlineTask task) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            if (count_ == ring_.size()) grow();
+            ring_[(head_ + count_) % ring_.size()] = std::move(task);
+            ++count_;
+        }
+        cv_.notify_one();
+    }
+
+    // Caller holds m_. Doubling keeps growth amortised; the ring never shrinks.
+    void grow() {
+        std::vector<InlineTask> bigger(ring_.size() * 2);
+        for (std::size_t i = 0; i < count_; ++i)
+            bigger[i] = std::move(ring_[(head_ + i) % ring_.size()]);
+        ring_.swap(bigger);
+        head_ = 0;
+    }
+
+    std::vector<std::thread> workers_;
+    std::vector<InlineTask> ring_;
+    std::size_t head_ = 0;
+    std::size_t count_ = 0;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+// ---------------- Demo ----------------
+int add(int a, int b) { return a + b; }
+
+// What code1's submit() does per job, minus the queue.
+long legacy_allocs_per_job() {
+    long before = g_allocs.load();
+    auto pkg = std::make_shared<std::packaged_task<int()>>(std::bind(add, 1, 2));
+    auto fut = pkg->get_future();
+    std::function<void()> task([pkg]{ (*pkg)(); });
+    return g_allocs.load() - before;
+}
+
+int main() {
+    ThreadPool pool(4);
+
+    auto f1 = pool.submit(add, 21, 21);
+    auto f2 = pool.submit([](int x){ return x * x; }, 12);
+    auto f3 = pool.submit([]() -> int { throw std::runtime_error("job failed"); });
+    auto f4 = pool.submit([]{ std::cout << "void job on " << std::this_thread::get_id() << "\n"; });
+
+    std::cout << "add: " << f1.get() << "\n";   // 42
+    std::cout << "sq : " << f2.get() << "\n";   // 144
+    try { f3.get(); } catch (const std::exception& e) { std::cout << "f3 : " << e.what() << "\n"; }
+    f4.get();
+
+    // Warm the free lists and the ring, then count allocations in steady state.
+    const int N = 10'000;
+    std::vector<TaskFuture<int>> futs;
+    futs.reserve(N);
+    for (int round = 0; round < 2; ++round) {
+        long before = g_allocs.load();
+        for (int i = 0; i < N; ++i) futs.push_back(pool.submit(add, i, 1));
+        long long sum = 0;
+        for (auto& f : futs) sum += f.get();
+        futs.clear();
+        long allocs = g_allocs.load() - before;
+        std::cout << "round " << round << ": sum=" << sum
+                  << " heap allocations for " << N << " jobs: " << allocs << "\n";
+    }
+    std::cout << "code1-style submit: " << legacy_allocs_per_job() << " allocations per job\n";
+}
@@ -0,0 +1,225 @@
+// batch_submit.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code6-batch.cpp -o code6
+//
+// code1's pool plus two bulk entry points:
+//   submit_batch(first, last)          : N callables -> N futures, ONE lock, ONE notify_all
+//   parallel_for(begin, end, grain, fn): chunks [begin, end) across workers,
+//                                        returns ONE future for the whole range
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    std::size_t size() const { return workers_.size(); }
+
+    // Fire-and-forget: just ignore the returned future
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit and get a future result
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.emplace([pkg]{ (*pkg)(); });
+        }
+        cv_.notify_one();
+        return fut;
+    }
+
+    // Submit every callable in [first, last); each must be invocable with no
+    // arguments. Packaging happens outside the lock, the queue is locked once.
+    template<class It>
+    auto submit_batch(It first, It last)
+      -> std::vector<std::future<std::invoke_result_t<typename std::iterator_traits<It>::reference>>>
+    {
+        using R = std::invoke_result_t<typename std::iterator_traits<It>::reference>;
+        std::vector<std::future<R>> futs;
+        std::vector<std::function<void()>> tasks;
+        for (; first != last; ++first) {
+            auto pkg = std::make_shared<std::packaged_task<R()>>(*first);
+            futs.push_back(pkg->get_future());
+            tasks.emplace_back([pkg]{ (*pkg)(); });
+        }
+        push_all(tasks);
+        return futs;
+    }
+
+    // Runs fn(i) for every i in [begin, end), grain indices per task
+    // (grain == 0 picks ~4 chunks per worker). The returned future is ready
+    // when every chunk has finished; the first exception thrown wins.
+    template<class Index, class Fn>
+    std::future<void> parallel_for(Index begin, Index end, Index grain, Fn fn) {
+        struct Join {
+            std::atomic<std::size_t> remaining{0};
+            std::promise<void> done;
+            std::mutex err_m;
+            std::exception_ptr err;
+
+            void finish() {
+                if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+                if (err) done.set_exception(err);
+                else     done.set_value();
+            }
+        };
+
+        auto join = std::make_shared<Join>();
+        auto fut = join->done.get_future();
+        if (!(begin < end)) { join->done.set_value(); return fut; }
+
+        const Index n = end - begin;
+        if (grain <= 0) {
+            Index chunks = static_cast<Index>(workers_.size() * 4);
+            grain = std::max<Index>(1, (n + chunks - 1) / chunks);
+        }
+
+        auto shared_fn = std::make_shared<Fn>(std::move(fn));
+        std::vector<std::function<void()>> tasks;
+        for (Index lo = begin; lo < end; ) {
+            Index hi = (end - lo > grain) ? lo + grain : end;
+            tasks.emplace_back([join, shared_fn, lo, hi]{
+                try {
+                    for (Index i = lo; i < hi; ++i) (*shared_fn)(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lk(join->err_m);
+                    if (!join->err) join->err = std::current_exception();
+                }
+                join->finish();
+            });
+            lo = hi;
+        }
+        join->remaining.store(tasks.size(), std::memory_order_relaxed);
+        push_all(tasks);
+        return fut;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    void push_all(std::vector<std::function<void()>>& tasks) {
+        if (tasks.empty()) return;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            for (auto& t : tasks) q_.push(std::move(t));
+        }
+        if (tasks.size() == 1) cv_.notify_one();
+        else                   cv_.notify_all();
+    }
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- Demo ----------------
+bool is_prime(int x) {
+    if (x < 2) return false;
+    for (int d = 2; d * d <= x; ++d) if (x % d == 0) return false;
+    return true;
+}
+
+int main() {
+    using clock_type = std::chrono::steady_clock;
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    ThreadPool pool(4);
+    const int JOBS = 20'000;
+
+    // Many tiny jobs: one-by-one vs batch.
+    std::vector<std::function<long long()>> jobs;
+    for (int j = 0; j < JOBS; ++j)
+        jobs.emplace_back([j]{ long long s = 0; for (int i = 0; i <= j % 100; ++i) s += i; return s; });
+
+    auto s = clock_type::now();
+    std::vector<std::future<long long>> futs;
+    for (auto& job : jobs) futs.push_back(pool.submit(job));
+    long long one_by_one = 0;
+    for (auto& f : futs) one_by_one += f.get();
+    auto e = clock_type::now();
+    std::cout << "submit x" << JOBS << ":     " << one_by_one << " in "
+              << duration_cast<microseconds>(e - s).count() << " us\n";
+
+    s = clock_type::now();
+    auto bfuts = pool.submit_batch(jobs.begin(), jobs.end());
+    long long batched = 0;
+    for (auto& f : bfuts) batched += f.get();
+    e = clock_type::now();
+    std::cout << "submit_batch x" << JOBS << ": " << batched << " in "
+              << duration_cast<microseconds>(e - s).count() << " us\n";
+
+    // parallel_for: count primes in [0, 2'000'000) with one aggregate future.
+    std::atomic<long> primes{0};
+    s = clock_type::now();
+    pool.parallel_for(0, 2'000'000, 0, [&](int i){
+        if (is_prime(i)) primes.fetch_add(1, std::memory_order_relaxed);
+    }).get();
+    e = clock_type::now();
+    std::cout << "parallel_for primes < 2e6: " << primes.load()      // 148933
+              << " in " << duration_cast<microseconds>(e - s).count() << " us\n";
+
+    // Exceptions from any chunk reach the aggregate future.
+    try {
+        pool.parallel_for(0, 100, 10, [](int i){
+            if (i == 42) throw std::runtime_error("bad index 42");
+        }).get();
+    } catch (const std::exception& ex) {
+        std::cout << "parallel_for error: " << ex.what() << "\n";
+    }
+}
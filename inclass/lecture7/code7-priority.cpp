@@ -0,0 +1,238 @@
+// priority_pool.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code7-priority.cpp -o code7
+//
+// ThreadPool with priority bands instead of one FIFO:
+//   submit(Priority::High, f, args...)  -> served before Normal/Low
+//   submit(f, args...)                  -> Priority::Normal (old API unchanged)
+// Aging: once the oldest job in a lower band has waited longer than that band's
+// aging limit, it is served next regardless of higher bands, so a steady stream
+// of High jobs cannot starve Low ones.
+// Per-band metrics record how long jobs sat in the queue.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum class Priority { High = 0, Normal = 1, Low = 2 };
+constexpr std::size_t kBands = 3;
+
+const char* to_string(Priority p) {
+    switch (p) {
+        case Priority::High:   return "high";
+        case Priority::Normal: return "normal";
+        case Priority::Low:    return "low";
+    }
+    return "?";
+}
+
+struct BandStats {
+    std::uint64_t submitted = 0;
+    std::uint64_t completed = 0;
+    std::uint64_t aged = 0;             // served early because of aging
+    double avg_wait_us = 0;
+    double max_wait_us = 0;
+};
+
+class ThreadPool {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    // aging: how long a Normal/Low job may wait before it jumps the queue.
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency(),
+                        std::chrono::milliseconds aging_normal = std::chrono::milliseconds(20),
+                        std::chrono::milliseconds aging_low = std::chrono::milliseconds(100))
+    : aging_{{clock_type::duration::max(), aging_normal, aging_low}} {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    Entry e;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || pending_ != 0; });
+                        if (stop_ && pending_ == 0) return;
+                        e = take_next();
+                    }
+                    try { e.task(); } catch (...) { /* swallow/log */ }
+                    stats_[e.band].completed.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+    }
+
+    // Fire-and-forget: just ignore the returned future
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit at Normal priority (same API as code1)
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        return submit(Priority::Normal, std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit at an explicit priority
+    template<class F, class... A>
+    auto submit(Priority p, F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        const auto band = static_cast<std::size_t>(p);
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            bands_[band].push_back(Entry{[pkg]{ (*pkg)(); }, clock_type::now(), band});
+            ++pending_;
+        }
+        stats_[band].submitted.fetch_add(1, std::memory_order_relaxed);
+        cv_.notify_one();
+        return fut;
+    }
+
+    BandStats stats(Priority p) const {
+        const Counters& c = stats_[static_cast<std::size_t>(p)];
+        BandStats s;
+        s.submitted = c.submitted.load(std::memory_order_relaxed);
+        s.completed = c.completed.load(std::memory_order_relaxed);
+        s.aged = c.aged.load(std::memory_order_relaxed);
+        std::uint64_t started = c.started.load(std::memory_order_relaxed);
+        if (started)
+            s.avg_wait_us = c.wait_ns.load(std::memory_order_relaxed) / 1000.0 / started;
+        s.max_wait_us = c.max_wait_ns.load(std::memory_order_relaxed) / 1000.0;
+        return s;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    struct Entry {
+        std::function<void()> task;
+        clock_type::time_point enqueued;
+        std::size_t band = 0;
+    };
+
+    struct Counters {
+        std::atomic<std::uint64_t> submitted{0};
+        std::atomic<std::uint64_t> started{0};
+        std::atomic<std::uint64_t> completed{0};
+        std::atomic<std::uint64_t> aged{0};
+        std::atomic<std::uint64_t> wait_ns{0};
+        std::atomic<std::uint64_t> max_wait_ns{0};
+    };
+
+    // Caller holds m_ and pending_ > 0.
+    Entry take_next() {
+        const auto now = clock_type::now();
+
+        // Aged job first: the lowest band whose head has waited too long.
+        std::size_t pick = kBands;
+        bool aged = false;
+        for (std::size_t b = kBands; b-- > 1; ) {
+            if (!bands_[b].empty() && now - bands_[b].front().enqueued >= aging_[b]) {
+                pick = b;
+                aged = true;
+                break;
+            }
+        }
+        // Otherwise strict priority.
+        if (pick == kBands) {
+            for (std::size_t b = 0; b < kBands; ++b)
+                if (!bands_[b].empty()) { pick = b; break; }
+        }
+        // Only count as aged if a higher band actually had work waiting.
+        if (aged) {
+            aged = false;
+            for (std::size_t b = 0; b < pick; ++b) aged = aged || !bands_[b].empty();
+        }
+
+        Entry e = std::move(bands_[pick].front());
+        bands_[pick].pop_front();
+        --pending_;
+
+        Counters& c = stats_[pick];
+        auto waited = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - e.enqueued).count());
+        c.started.fetch_add(1, std::memory_order_relaxed);
+        c.wait_ns.fetch_add(waited, std::memory_order_relaxed);
+        if (waited > c.max_wait_ns.load(std::memory_order_relaxed))
+            c.max_wait_ns.store(waited, std::memory_order_relaxed);   // m_ held: no CAS needed
+        if (aged) c.aged.fetch_add(1, std::memory_order_relaxed);
+        return e;
+    }
+
+    std::vector<std::thread> workers_;
+    std::array<std::deque<Entry>, kBands> bands_;
+    std::array<clock_type::duration, kBands> aging_;
+    std::array<Counters, kBands> stats_;
+    std::size_t pending_ = 0;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+// ---------------- Demo ----------------
+long long sum_range(long long l, long long r) {
+    long long s = 0;
+    for (long long i = l; i <= r; ++i) s += i;
+    return s;
+}
+
+int main() {
+    using namespace std::chrono;
+    ThreadPool pool(2);
+
+    // Backlog of big Low jobs, then one latency-sensitive High job.
+    std::vector<std::future<long long>> low;
+    for (int i = 0; i < 20; ++i)
+        low.push_back(pool.submit(Priority::Low, sum_range, 1, 10'000'000));
+
+    auto t0 = ThreadPool::clock_type::now();
+    auto hi = pool.submit(Priority::High, sum_range, 1, 1000);
+    std::cout << "high result " << hi.get() << " after "
+              << duration_cast<milliseconds>(ThreadPool::clock_type::now() - t0).count()
+              << " ms with 20 low jobs queued ahead\n";
+
+    // A steady stream of High work: aging still lets the Low backlog through.
+    for (int i = 0; i < 200; ++i) {
+        pool.enqueue(Priority::High, [] { std::this_thread::sleep_for(milliseconds(1)); });
+        if (i % 10 == 0) pool.enqueue([] { return sum_range(1, 1000); });   // Normal
+    }
+    for (auto& f : low) f.get();
+
+    for (Priority p : {Priority::High, Priority::Normal, Priority::Low}) {
+        BandStats s = pool.stats(p);
+        std::cout << to_string(p) << ": submitted=" << s.submitted
+                  << " completed=" << s.completed
+                  << " aged=" << s.aged
+                  << " avg_wait=" << s.avg_wait_us << "us"
+                  << " max_wait=" << s.max_wait_us << "us\n";
+    }
+}
@@ -0,0 +1,277 @@
+// pool_telemetry.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code8-telemetry.cpp -o code8
+//
+// code1's pool, instrumented:
+//   - queue wait (enqueue -> start) and run time (start -> finish) per task
+//   - queue depth sampled by the worker at every pop
+//   - busy time per worker -> utilization
+// Each worker writes only its own histograms (log-linear buckets, ~6% precision,
+// HDR style), using relaxed load+store instead of locked RMW. snapshot() merges
+// all workers while the pool keeps running.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ---------------- Histogram (single writer, many readers) ----------------
+class Histogram {
+public:
+    static constexpr int kSubBits = 4;                         // 16 sub-buckets per power of two
+    static constexpr int kSub = 1 << kSubBits;
+    static constexpr int kBuckets = (64 - kSubBits + 1) * kSub;
+
+    // Owner thread only.
+    void record(std::uint64_t v) {
+        auto& c = counts_[index_of(v)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        total_.store(total_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        if (v > max_.load(std::memory_order_relaxed)) max_.store(v, std::memory_order_relaxed);
+    }
+
+    static int index_of(std::uint64_t v) {
+        if (v < static_cast<std::uint64_t>(kSub)) return static_cast<int>(v);
+        int msb = 63 - __builtin_clzll(v);
+        int sub = static_cast<int>((v >> (msb - kSubBits)) & (kSub - 1));
+        return (msb - kSubBits + 1) * kSub + sub;
+    }
+
+    // Smallest value that maps to bucket i.
+    static std::uint64_t lower_bound_of(int i) {
+        if (i < kSub) return static_cast<std::uint64_t>(i);
+        int e = i / kSub, sub = i % kSub;
+        return static_cast<std::uint64_t>(kSub + sub) << (e - 1);
+    }
+
+    friend class HistogramSnapshot;
+
+private:
+    std::array<std::atomic<std::uint64_t>, kBuckets> counts_{};
+    std::atomic<std::uint64_t> total_{0};
+    std::atomic<std::uint64_t> sum_{0};
+    std::atomic<std::uint64_t> max_{0};
+};
+
+// Plain copy of one or more Histograms; safe to query at leisure.
+class HistogramSnapshot {
+public:
+    void merge(const Histogram& h) {
+        for (int i = 0; i < Histogram::kBuckets; ++i)
+            counts_[i] += h.counts_[i].load(std::memory_order_relaxed);
+        total_ += h.total_.load(std::memory_order_relaxed);
+        sum_ += h.sum_.load(std::memory_order_relaxed);
+        max_ = std::max(max_, h.max_.load(std::memory_order_relaxed));
+    }
+
+    std::uint64_t count() const { return total_; }
+    std::uint64_t max() const { return max_; }
+    double mean() const { return total_ ? static_cast<double>(sum_) / total_ : 0.0; }
+
+    // q in [0, 1]. Returns the lower edge of the bucket holding the q-quantile.
+    std::uint64_t percentile(double q) const {
+        std::uint64_t n = 0;
+        for (auto c : counts_) n += c;                 // buckets may be ahead of total_
+        if (!n) return 0;
+        auto rank = static_cast<std::uint64_t>(q * static_cast<double>(n - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (int i = 0; i < Histogram::kBuckets; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) return std::min(Histogram::lower_bound_of(i), max_);
+        }
+        return max_;
+    }
+
+private:
+    std::array<std::uint64_t, Histogram::kBuckets> counts_{};
+    std::uint64_t total_ = 0, sum_ = 0, max_ = 0;
+};
+
+struct PoolTelemetry {
+    HistogramSnapshot queue_wait_ns;
+    HistogramSnapshot run_time_ns;
+    HistogramSnapshot queue_depth;
+    std::vector<double> utilization;     // per worker, busy / wall since start
+    std::uint64_t tasks_completed = 0;
+};
+
+// ---------------- ThreadPool ----------------
+class ThreadPool {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : start_(clock_type::now()) {
+        if (!n) n = 1;
+        stats_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) stats_.push_back(std::make_unique<WorkerStats>());
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this, &ws = *stats_[i]] {
+                for (;;) {
+                    QueuedTask task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        ws.queue_depth.record(q_.size());
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    auto started = clock_type::now();
+                    try { task.fn(); } catch (...) { /* swallow/log */ }
+                    auto finished = clock_type::now();
+                    ws.queue_wait.record(to_ns(started - task.enqueued));
+                    auto ran = to_ns(finished - started);
+                    ws.run_time.record(ran);
+                    ws.busy_ns.store(ws.busy_ns.load(std::memory_order_relaxed) + ran,
+                                     std::memory_order_relaxed);
+                }
+            });
+        }
+    }
+
+    // Fire-and-forget: just ignore the returned future
+    template<class F, class... A>
+    void enqueue(F&& f, A&&... a) {
+        (void)submit(std::forward<F>(f), std::forward<A>(a)...);
+    }
+
+    // Submit and get a future result
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.push(QueuedTask{[pkg]{ (*pkg)(); }, clock_type::now()});
+        }
+        cv_.notify_one();
+        return fut;
+    }
+
+    // Merges every worker's data without pausing them. Counters are read
+    // individually, so a snapshot taken mid-task may be off by that task.
+    PoolTelemetry snapshot() const {
+        PoolTelemetry t;
+        double wall = static_cast<double>(to_ns(clock_type::now() - start_));
+        for (const auto& ws : stats_) {
+            t.queue_wait_ns.merge(ws->queue_wait);
+            t.run_time_ns.merge(ws->run_time);
+            t.queue_depth.merge(ws->queue_depth);
+            t.utilization.push_back(ws->busy_ns.load(std::memory_order_relaxed) / wall);
+        }
+        t.tasks_completed = t.run_time_ns.count();
+        return t;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    struct QueuedTask {
+        std::function<void()> fn;
+        clock_type::time_point enqueued;
+    };
+
+    // One per worker, on its own cache lines; written only by that worker.
+    struct alignas(64) WorkerStats {
+        Histogram queue_wait;
+        Histogram run_time;
+        Histogram queue_depth;
+        std::atomic<std::uint64_t> busy_ns{0};
+    };
+
+    static std::uint64_t to_ns(clock_type::duration d) {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    }
+
+    const clock_type::time_point start_;
+    std::vector<std::unique_ptr<WorkerStats>> stats_;
+    std::vector<std::thread> workers_;
+    std::queue<QueuedTask> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+// ---------------- Demo ----------------
+void print(const char* name, const HistogramSnapshot& h, const char* unit) {
+    std::cout << std::left << std::setw(11) << name
+              << " n=" << h.count()
+              << " mean=" << static_cast<std::uint64_t>(h.mean()) << unit
+              << " p50=" << h.percentile(0.50) << unit
+              << " p99=" << h.percentile(0.99) << unit
+              << " p999=" << h.percentile(0.999) << unit
+              << " max=" << h.max() << unit << "\n";
+}
+
+void print(const PoolTelemetry& t) {
+    print("queue_wait", t.queue_wait_ns, "ns");
+    print("run_time", t.run_time_ns, "ns");
+    print("depth", t.queue_depth, "");
+    std::cout << "utilization:";
+    for (double u : t.utilization) std::cout << " " << std::fixed << std::setprecision(2) << u;
+    std::cout << std::defaultfloat << "\n";
+}
+
+int main() {
+    using namespace std::chrono;
+
+    // Cost of one record() on the hot path.
+    {
+        Histogram h;
+        const int N = 10'000'000;
+        auto s = steady_clock::now();
+        for (int i = 0; i < N; ++i) h.record(static_cast<std::uint64_t>(i) * 37);
+        auto e = steady_clock::now();
+        std::cout << "record(): "
+                  << duration_cast<nanoseconds>(e - s).count() / static_cast<double>(N)
+                  << " ns/op\n";
+    }
+
+    ThreadPool pool(4);
+    std::vector<std::future<long long>> futs;
+    for (int i = 0; i < 2000; ++i) {
+        futs.push_back(pool.submit([i]{
+            long long s = 0;
+            int n = (i % 50 == 0) ? 2'000'000 : 20'000;         // a few slow ones
+            for (int k = 0; k < n; ++k) s += k ^ i;
+            return s;
+        }));
+        if (i == 1000) {                                          // live snapshot mid-run
+            futs[500].wait();
+            std::cout << "--- mid-run ---\n";
+            print(pool.snapshot());
+        }
+    }
+    for (auto& f : futs) f.get();
+    std::cout << "--- final ---\n";
+    print(pool.snapshot());
+}
@@ -0,0 +1,319 @@
+// prime_sieve_job.cpp
+// Build:
+//   g++ -std=c++17 -O2 -pthread code9-prime-sieve.cpp -o code9
+//
+// PrimeCountJob(l, r) from the README, backed by a segmented Sieve of
+// Eratosthenes instead of trial division:
+//   - only odd numbers are stored, one bit each
+//   - each segment is 32 KB of bits (fits L1), covering 524288 integers
+//   - base primes up to sqrt(r) are computed once and reused across jobs
+//   - with a pool, contiguous runs of segments are spread across workers
+//     and the caller helps run them while it waits, so a job may split
+//     itself from inside the same pool
+// main() benchmarks naive vs sieve at 1, 2, 4 and 8 threads.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ---------------- ThreadPool (as in code1) ----------------
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t n = std::thread::hardware_concurrency())
+    : stop_(false) {
+        if (!n) n = 1;
+        workers_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+                        if (stop_ && q_.empty()) return;
+                        task = std::move(q_.front());
+                        q_.pop();
+                    }
+                    try { task(); } catch (...) { /* swallow/log */ }
+                }
+            });
+        }
+    }
+
+    std::size_t size() const { return workers_.size(); }
+
+    template<class F, class... A>
+    auto submit(F&& f, A&&... a)
+      -> std::future<std::invoke_result_t<F, A...>>
+    {
+        using R = std::invoke_result_t<F, A...>;
+        auto pkg = std::make_shared<std::packaged_task<R()>>(
+            std::bind(std::forward<F>(f), std::forward<A>(a)...));
+        auto fut = pkg->get_future();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stop_) throw std::runtime_error("submit on stopped pool");
+            q_.emplace([pkg]{ (*pkg)(); });
+        }
+        cv_.notify_one();
+        return fut;
+    }
+
+    // Runs one queued task on the calling thread; false if there was none.
+    bool run_one() {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (q_.empty()) return false;
+            task = std::move(q_.front());
+            q_.pop();
+        }
+        try { task(); } catch (...) { /* swallow/log */ }
+        return true;
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) if (t.joinable()) t.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> q_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// ---------------- Jobs ----------------
+struct JobResult {
+    bool success;
+    std::string message;
+    int value;
+};
+
+class Job {
+public:
+    virtual ~Job() = default;
+    virtual JobResult run() = 0;
+};
+
+// ---------------- Segmented sieve ----------------
+class SegmentedSieve {
+public:
+    static constexpr std::size_t kSegmentBytes = 32 * 1024;
+    static constexpr std::uint64_t kSegmentBits = kSegmentBytes * 8;
+    static constexpr std::uint64_t kSegmentSpan = kSegmentBits * 2;   // odd-only
+
+    // Number of primes in [l, r]. Uses the pool when given one.
+    static std::uint64_t count(std::uint64_t l, std::uint64_t r, ThreadPool* pool = nullptr) {
+        if (r < 2 || l > r) return 0;
+        l = std::max<std::uint64_t>(l, 1);
+        auto base = base_primes(isqrt(r));
+
+        const std::uint64_t segments = (r - l) / kSegmentSpan + 1;
+        auto run_segments = [base, l, r](std::uint64_t first, std::uint64_t last) {
+            std::vector<std::uint64_t> bits(kSegmentBits / 64);        // reused per segment
+            std::uint64_t n = 0;
+            for (std::uint64_t s = first; s < last; ++s) {
+                std::uint64_t lo = l + s * kSegmentSpan;
+                std::uint64_t hi = std::min(r, lo + kSegmentSpan - 1);
+                n += count_segment(lo, hi, *base, bits);
+            }
+            return n;
+        };
+
+        std::uint64_t total = (l <= 2 && 2 <= r) ? 1 : 0;               // the only even prime
+        if (!pool || pool->size() == 1 || segments == 1)
+            return total + run_segments(0, segments);
+
+        // A few contiguous runs per worker: enough to balance, few enough
+        // that every task still sweeps many L1-sized segments.
+        const std::uint64_t tasks = std::min<std::uint64_t>(segments, pool->size() * 4);
+        std::vector<std::future<std::uint64_t>> futs;
+        for (std::uint64_t t = 0; t < tasks; ++t)
+            futs.push_back(pool->submit(run_segments, segments * t / tasks,
+                                        segments * (t + 1) / tasks));
+        for (auto& f : futs) {
+            // Help instead of blocking: count() may itself be running on one
+            // of pool's workers, with its runs queued behind it.
+            while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                if (!pool->run_one()) { f.wait(); break; }
+            total += f.get();
+        }
+        return total;
+    }
+
+private:
+    using PrimeTable = std::vector<std::uint32_t>;
+
+    static std::uint64_t isqrt(std::uint64_t x) {
+        auto s = static_cast<std::uint64_t>(std::sqrt(static_cast<double>(x)));
+        while (s * s > x) --s;
+        while ((s + 1) * (s + 1) <= x) ++s;
+        return s;
+    }
+
+    // Odd primes <= limit. The table only ever grows (doubling), and callers
+    // keep the snapshot they got, so a concurrent grow never disturbs them.
+    static std::shared_ptr<const PrimeTable> base_primes(std::uint64_t limit) {
+        static std::mutex m;
+        static std::shared_ptr<const PrimeTable> table;
+        static std::uint64_t table_limit = 0;
+
+        std::lock_guard<std::mutex> lk(m);
+        if (table && table_limit >= limit) return table;
+        std::uint64_t n = std::max<std::uint64_t>({limit, table_limit * 2, 1024});
+        std::vector<bool> composite(n + 1, false);
+        auto primes = std::make_shared<PrimeTable>();
+        for (std::uint64_t i = 3; i <= n; i += 2) {
+            if (composite[i]) continue;
+            primes->push_back(static_cast<std::uint32_t>(i));
+            for (std::uint64_t j = i * i; j <= n; j += 2 * i) composite[j] = true;
+        }
+        table = std::move(primes);
+        table_limit = n;
+        return table;
+    }
+
+    // Primes among the odd numbers of [lo, hi]; bit i stands for first_odd + 2i.
+    static std::uint64_t count_segment(std::uint64_t lo, std::uint64_t hi,
+                                       const PrimeTable& base,
+                                       std::vector<std::uint64_t>& bits) {
+        const std::uint64_t first_odd = lo | 1;
+        if (first_odd > hi) return 0;
+        const std::uint64_t nbits = (hi - first_odd) / 2 + 1;
+        const std::size_t words = static_cast<std::size_t>((nbits + 63) / 64);
+        std::fill(bits.begin(), bits.begin() + words, 0);
+
+        if (first_odd == 1) bits[0] |= 1;                              // 1 is not prime
+        for (std::uint32_t p32 : base) {
+            const std::uint64_t p = p32;
+            if (p * p > hi) break;
+            std::uint64_t start = p * p;
+            if (start < first_odd) {
+                start = (first_odd + p - 1) / p * p;
+                if ((start & 1) == 0) start += p;
+            }
+            for (std::uint64_t n = start; n <= hi; n += 2 * p) {
+                std::uint64_t i = (n - first_odd) / 2;
+                bits[i / 64] |= std::uint64_t{1} << (i % 64);
+            }
+        }
+
+        std::uint64_t composites = 0;
+        for (std::size_t w = 0; w + 1 < words; ++w) composites += __builtin_popcountll(bits[w]);
+        const std::uint64_t tail = nbits - (words - 1) * 64;            // 1..64 valid bits
+        const std::uint64_t mask = tail == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << tail) - 1;
+        composites += __builtin_popcountll(bits[words - 1] & mask);
+        return nbits - composites;
+    }
+};
+
+// Counts primes in [l, r]. Pass a pool to split the range across its workers.
+class PrimeCountJob : public Job {
+public:
+    PrimeCountJob(int l, int r, ThreadPool* pool = nullptr) : l_(l), r_(r), pool_(pool) {}
+
+    JobResult run() override {
+        if (l_ > r_) return {false, "Failed: empty range", 0};
+        auto n = SegmentedSieve::count(static_cast<std::uint64_t>(std::max(l_, 0)),
+                                       static_cast<std::uint64_t>(std::max(r_, 0)), pool_);
+        return {true, "OK", static_cast<int>(n)};
+    }
+
+private:
+    int l_, r_;
+    ThreadPool* pool_;
+};
+
+// ---------------- Naive baseline (trial division) ----------------
+bool is_prime(int x) {
+    if (x < 2) return false;
+    if (x % 2 == 0) return x == 2;
+    for (int d = 3; d * d <= x; d += 2) if (x % d == 0) return false;
+    return true;
+}
+
+int naive_count(int l, int r, ThreadPool& pool) {
+    const int tasks = static_cast<int>(pool.size()) * 4;
+    std::vector<std::future<int>> futs;
+    for (int t = 0; t < tasks; ++t) {
+        int lo = l + static_cast<int>(static_cast<long long>(r - l + 1) * t / tasks);
+        int hi = l + static_cast<int>(static_cast<long long>(r - l + 1) * (t + 1) / tasks) - 1;
+        futs.push_back(pool.submit([lo, hi]{
+            int n = 0;
+            for (int x = lo; x <= hi; ++x) n += is_prime(x);
+            return n;
+        }));
+    }
+    int n = 0;
+    for (auto& f : futs) n += f.get();
+    return n;
+}
+
+// ---------------- Demo / benchmark ----------------
+template<class Fn>
+double time_ms(Fn&& fn) {
+    auto s = std::chrono::steady_clock::now();
+    fn();
+    auto e = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(e - s).count();
+}
+
+int main() {
+    // Correctness on small and awkward ranges.
+    std::cout << "pi(100)        = " << PrimeCountJob(1, 100).run().value << "\n";       // 25
+    std::cout << "primes [90,97] = " << PrimeCountJob(90, 97).run().value << "\n";       // 1
+    std::cout << "pi(1e7)        = " << PrimeCountJob(1, 10'000'000).run().value << "\n"; // 664579
+    {
+        // Jobs on every worker, each splitting into the same pool: their
+        // runs queue up behind them, so waiting must mean helping.
+        ThreadPool pool(2);
+        PrimeCountJob job(1, 10'000'000, &pool);
+        std::atomic<int> started{0};
+        auto nested = [&]{
+            started.fetch_add(1);
+            while (started.load() < 2) std::this_thread::yield();     // both workers taken
+            return job.run().value;
+        };
+        auto f1 = pool.submit(nested);
+        auto f2 = pool.submit(nested);
+        std::cout << "pi(1e7) nested = " << f1.get() << ", " << f2.get() << "\n";
+    }
+
+    const int NAIVE_R = 2'000'000;          // pi = 148933
+    const int SIEVE_R = 100'000'000;        // pi = 5761455
+    std::cout << "\nthreads | naive [1," << NAIVE_R << "] | sieve [1," << NAIVE_R
+              << "] | sieve [1," << SIEVE_R << "]\n";
+    for (std::size_t threads : {1, 2, 4, 8}) {
+        ThreadPool pool(threads);
+        int a = 0, b = 0, c = 0;
+        double ta = time_ms([&]{ a = naive_count(1, NAIVE_R, pool); });
+        double tb = time_ms([&]{ b = PrimeCountJob(1, NAIVE_R, &pool).run().value; });
+        double tc = time_ms([&]{ c = PrimeCountJob(1, SIEVE_R, &pool).run().value; });
+        std::cout << std::setw(7) << threads << " | "
+                  << std::setw(8) << a << " " << std::setw(7) << std::fixed << std::setprecision(1) << ta << " ms | "
+                  << std::setw(8) << b << " " << std::setw(7) << tb << " ms | "
+                  << std::setw(8) << c << " " << std::setw(7) << tc << " ms\n";
+    }
+}